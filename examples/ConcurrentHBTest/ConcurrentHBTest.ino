@@ -0,0 +1,125 @@
+/*
+ * ConcurrentHBTest
+ *     Stress test for ConcurrentHistoryBuffer on an ESP32. A writer task on one
+ *     core pushes items as fast as it can while reader tasks on the other core
+ *     take snapshots and check that every one of them is consistent.
+ *
+ * NOTES:
+ * o Each item is built so that a torn copy is detectable: its fields are all
+ *   derived from one counter, and consecutive items have consecutive counters.
+ * o The writer runs alone first, then with the readers, so the cost that the
+ *   readers impose on the writer shows up in the report.
+ *
+ */
+
+#if !defined(ESP32)
+  #error "This test needs a dual core ESP32"
+#endif
+
+#include <ArduinoJson.h>
+#include <ArduinoLog.h>
+#include <ConcurrentHistoryBuffer.h>
+
+static constexpr size_t HistorySize = 256;
+static constexpr size_t SnapshotSize = 100;
+static constexpr int NReaders = 2;
+static constexpr uint32_t SoloMillis = 2000;
+static constexpr uint32_t SharedMillis = 10000;
+
+class Sample : public Serializable {
+public:
+  uint32_t n = 0;
+  float half = 0;
+  float twice = 0;
+
+  Sample() = default;
+  Sample(uint32_t count) : n(count), half(count / 2.0f), twice(count * 2.0f) { timestamp = count; }
+
+  bool consistent() const { return half == n / 2.0f && twice == n * 2.0f && timestamp == (time_t)n; }
+
+  virtual void internalize(const JsonObjectConst& obj) { *this = Sample(obj["n"].as<uint32_t>()); }
+
+  virtual void externalize(Stream& writeStream) const {
+    StaticJsonDocument<32> doc;
+    doc["n"] = n;
+    serializeJson(doc, writeStream);
+  }
+};
+
+ConcurrentHistoryBuffer<Sample, HistorySize> history;
+
+volatile bool readersRunning = false;
+volatile uint32_t snapshots[NReaders];
+volatile uint32_t badSnapshots = 0;
+
+void flushSerial(Print *p) { p->print(CR); Serial.flush(); }
+
+void prepLogging() {
+  Serial.begin(115200); while (!Serial) delay(20);
+  Log.begin(LOG_LEVEL_VERBOSE, &Serial, false);
+  Log.setSuffix(flushSerial);
+
+  // Separate out from the normal garbage that starts the output
+  delay(200);
+  Serial.print("\n\n");
+}
+
+void readerTask(void* param) {
+  int id = (intptr_t)param;
+  static Sample copies[NReaders][SnapshotSize];
+  Sample* dest = copies[id];
+
+  while (readersRunning) {
+    // Alternate between the newest items and a range in the middle
+    size_t n = (snapshots[id] & 1) ? history.snapshotNewest(SnapshotSize, dest)
+                                   : history.snapshot(HistorySize / 4, SnapshotSize, dest);
+    for (size_t i = 0; i < n; i++) {
+      if (!dest[i].consistent() || (i && dest[i].n != dest[i-1].n + 1)) { badSnapshots++; break; }
+    }
+    snapshots[id]++;
+  }
+  vTaskDelete(nullptr);
+}
+
+uint32_t pushFor(uint32_t duration, uint32_t& counter) {
+  uint32_t pushes = 0;
+  uint32_t start = millis();
+  while (millis() - start < duration) {
+    for (int i = 0; i < 100; i++) {
+      // Keep the counter small enough for the float fields to stay exact
+      if (++counter == (1UL << 22)) { counter = 0; history.clear(); }
+      history.push(Sample(counter));
+    }
+    pushes += 100;
+  }
+  return pushes;
+}
+
+void setup() {
+  prepLogging();
+  uint32_t counter = 0;
+
+  // loop() and this function run on core 1. The readers run on core 0.
+  uint32_t solo = pushFor(SoloMillis, counter);
+
+  readersRunning = true;
+  for (int i = 0; i < NReaders; i++) {
+    xTaskCreatePinnedToCore(readerTask, "reader", 4096, (void*)(intptr_t)i, 1, nullptr, 0);
+  }
+  uint32_t shared = pushFor(SharedMillis, counter);
+  readersRunning = false;
+  delay(100);
+
+  uint32_t totalSnapshots = 0;
+  for (int i = 0; i < NReaders; i++) totalSnapshots += snapshots[i];
+
+  Log.notice(F("Writer alone: %d pushes/s"), solo * 1000 / SoloMillis);
+  Log.notice(F("Writer with %d readers: %d pushes/s"), NReaders, shared * 1000 / SharedMillis);
+  Log.notice(F("Readers: %d snapshots/s of %d items"), totalSnapshots * 1000 / SharedMillis, SnapshotSize);
+  if (badSnapshots) Log.error(F("FAILED: %d inconsistent snapshots"), badSnapshots);
+  else Log.notice(F("PASSED: every snapshot was consistent"));
+}
+
+void loop() {
+
+}
@@ -4,6 +4,8 @@
 #include <Serializable.h>
 #include <HistoryBuffer.h>
 #include <HistoryBuffers.h>
+#include <ColumnarHistoryBuffer.h>
+#include <CompressedHistoryBuffer.h>
 #include "THPReadings.h"
 #include "BPABasics.h"
 
@@ -141,40 +143,159 @@ void testHistoryBuffers() {
   Log.verbose("\n===== Test: Complete");}
 
 void testHistoryBuffers2() {
-  // Log.verbose("\n===== Test: Storing multiple buffers using a HistoryBuffers object (v2)");
-  // HistoryBuffers<THPReadings, 3> buffers;
+  Log.verbose("\n===== Test: Storing multiple buffers using a HistoryBuffers object (v2)");
+  HistoryBuffers<THPReadings, 3> buffers;
+
+  static constexpr HBDescriptor descriptors[] {
+    {4, "hour", 23},
+    {5, "day", 34},
+    {6, "week", 119}
+  };
+  static THPReadings spaceForAllHistories[totalHistoryElements(descriptors)];
+
+  buffers.init(descriptors, spaceForAllHistories);
+
+  genRandomData(buffers.getMutable(0));
+  genRandomData(buffers.getMutable(1));
+  genRandomData(buffers.getMutable(2));
+
+  Log.verbose("\n-- About store a HistoryBuffers object");
+  buffers.store("/buffers.json");
+
+  Log.verbose("\n-- Clearing the individual buffers");
+  buffers.clearAll();
+
+  Log.verbose("\n-- Reloading the buffers from a file");
+  buffers.load("/buffers.json");
+
+  Log.verbose("\n-- Display the loaded values");
+  buffers.store(Serial);
+  Log.verbose("\n===== Test: Complete");
+}
+
+constexpr HBDescriptor StaticDescriptors[] {
+  {12, "hour", minutesToTime_t(5)},
+  {24, "day", hoursToTime_t(1)},
+  {28, "week", hoursToTime_t(6)}
+};
+StaticHistoryBuffers<THPReadings, 3, totalHistoryElements(StaticDescriptors)> staticBuffers;
+
+void testStaticHistoryBuffers() {
+  Log.verbose("\n===== Test: Storing multiple buffers using a StaticHistoryBuffers object");
+  staticBuffers.init(StaticDescriptors);
+
+  genRandomData(staticBuffers.getMutable(0));
+  genRandomData(staticBuffers.getMutable(1));
+  genRandomData(staticBuffers.getMutable(2));
+
+  Log.verbose("\n-- Display the values");
+  staticBuffers.store(Serial);
+  Log.verbose("\n===== Test: Complete");
+}
+
+void testBinaryHistoryBuffers() {
+  Log.verbose("\n===== Test: Storing multiple buffers in binary form");
+  HistoryBuffers<THPReadings, 3> buffers;
+  buffers.describe({12, "hour", minutesToTime_t(5)});
+  buffers.describe({24, "day", hoursToTime_t(1)});
+  buffers.describe({28, "week", hoursToTime_t(6)});
 
-  // HBDescriptor descriptors[] {
-  //   {4, "hour", 23},
-  //   {5, "day", 34},
-  //   {6, "week", 119}
-  // };
-  // THPReadings spaceForAllHistories[15];
+  genRandomData(buffers.getMutable(0));
+  genRandomData(buffers.getMutable(1));
+  genRandomData(buffers.getMutable(2));
 
-  // buffers.init(descriptors, spaceForAllHistories);
+  Log.verbose("\n-- About store a HistoryBuffers object in binary form");
+  buffers.storeBinary("/buffers.bin");
 
-  // genRandomData(buffers[0]);
-  // genRandomData(buffers[1]);
-  // genRandomData(buffers[2]);
+  Log.verbose("\n-- Converting the binary file to JSON");
+  buffers.convertToJson("/buffers.bin", "/buffers.json");
 
-  // // buffers.setBuffer(0, {&rawBuffers[0], "1", 12});
-  // // buffers.setBuffer(1, {&rawBuffers[1], "2", 24});
-  // // buffers.setBuffer(2, {&rawBuffers[2], "3", 28});
+  Log.verbose("\n-- Reloading the buffers from the JSON file");
+  buffers.clearAll();
+  buffers.load("/buffers.json");
 
-  // Log.verbose("\n-- About store a HistoryBuffers object");
-  // buffers.store("/buffers.json");
+  Log.verbose("\n-- Display the loaded values");
+  buffers.store(Serial);
+  Log.verbose("\n===== Test: Complete");
+}
 
-  // Log.verbose("\n-- Clearing the individual buffers");
-  // buffers.clear();
+void testAggregatedHistoryBuffers() {
+  Log.verbose("\n===== Test: Rolling up readings into coarser tiers");
+  HistoryBuffers<THPReadings, 2> buffers;
+  buffers.describe({12, "hour", minutesToTime_t(5)});
+  buffers.describe({24, "day", hoursToTime_t(1)});
 
-  // Log.verbose("\n-- Reloading the buffers from a file");
-  // buffers.load("/buffers.json");
+  // The day tier keeps the hourly mean of every reading, not just one sample
+  FieldAggregator<THPReadings, 3> dayRollup({
+    {&THPReadings::temp}, {&THPReadings::humidity}, {&THPReadings::pressure}
+  });
+  buffers.setAggregator(1, &dayRollup);
+
+  for (int i = 0; i < 24*12; i++) {
+    THPReadings reading(
+      ((float)random(1000))/10,
+      ((float)random(1000))/10,
+      ((float)random(10000))/10);
+    reading.timestamp = i * minutesToTime_t(5);
+    buffers.conditionalPushAll(reading);
+  }
 
-  // Log.verbose("\n-- Display the loaded values");
-  // buffers.store(Serial);
-  // Log.verbose("\n===== Test: Complete");
+  Log.verbose("\n-- Display the values");
+  buffers.store(Serial);
+  Log.verbose("\n===== Test: Complete");
+}
+
+
+void testColumnarHistoryBuffer() {
+  Log.verbose("\n===== Test: Columnar storage and per-field aggregates");
+  ColumnarHistoryBuffer<THPReadings, 0,
+      HB_COLUMN(THPReadings, temp),
+      HB_COLUMN(THPReadings, humidity),
+      HB_COLUMN(THPReadings, pressure),
+      HB_COLUMN(THPReadings, timestamp)> columns({24, "columns", 0});
+
+  for (int i = 0; i < 30; i++) {
+    THPReadings reading(
+      ((float)random(1000))/10,
+      ((float)random(1000))/10,
+      ((float)random(10000))/10);
+    reading.timestamp = i * minutesToTime_t(5);
+    columns.push(reading);
+  }
+
+  Log.verbose("Temp: min %F, max %F, mean %F", columns.min<0>(), columns.max<0>(), columns.mean<0>());
+  Log.verbose("Mean humidity of the 6 newest: %F", columns.mean<1>(columns.size() - 6, 6));
+
+  Log.verbose("\n-- Display the values");
+  columns.store(Serial);
+  Log.verbose("\n===== Test: Complete");
 }
 
+void testCompressedHistoryBuffer() {
+  Log.verbose("\n===== Test: Compressed in-memory history");
+  CompressedHistoryBuffer<THPReadings, 128,
+      HB_COLUMN(THPReadings, timestamp),
+      HB_COLUMN(THPReadings, temp),
+      HB_COLUMN(THPReadings, humidity),
+      HB_COLUMN(THPReadings, pressure)> week({16, "week", 0});
+
+  // Slowly changing readings at a regular interval compress well
+  float temp = 20, humidity = 50, pressure = 1013;
+  for (int i = 0; i < 500; i++) {
+    temp += ((float)random(11) - 5)/10;
+    humidity += ((float)random(5) - 2)/10;
+    THPReadings reading(temp, humidity, pressure);
+    reading.timestamp = i * minutesToTime_t(5);
+    week.push(reading);
+  }
+
+  Log.verbose("%d items in %d blocks (%d bytes), %d bytes uncompressed",
+      week.size(), week.blockCount(), week.blockCount() * 128, week.size() * sizeof(THPReadings));
+
+  Log.verbose("\n-- Display the values");
+  week.store(Serial);
+  Log.verbose("\n===== Test: Complete");
+}
 
 void setup() {
 	prepLogging();
@@ -186,6 +307,11 @@ void setup() {
 
   testHistoryBuffers();
   testHistoryBuffers2();
+  testStaticHistoryBuffers();
+  testBinaryHistoryBuffers();
+  testAggregatedHistoryBuffers();
+  testColumnarHistoryBuffer();
+  testCompressedHistoryBuffer();
 }
 
 void loop() {
@@ -6,8 +6,8 @@
  * NOTES:
  * o This class can internalize itself from JSON and externalize itself to
  *   JSON as defined in the Serializable interface.
- * o Only the core T, H, & P values are externalized since the others can
- *   be re-rederived from them.
+ * o Only the core T, H, & P values and the timestamp are externalized since
+ *   the others can be re-rederived from them.
  *
  */
 
@@ -90,9 +90,37 @@ public:
     doc["temp"] = temp;
     doc["humidity"] = humidity;
     doc["pressure"] = pressure;
+    doc["timestamp"] = timestamp;
     serializeJson(doc, writeStream);
   }
 
+  virtual void externalizeTo(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.field("temp", temp);
+    writer.field("humidity", humidity);
+    writer.field("pressure", pressure);
+    writer.field("timestamp", timestamp);
+    writer.endObject();
+  }
+
+  // Binary form: temp, humidity, pressure, and timestamp, 4 bytes each
+  virtual size_t binarySize() const { return 16; }
+
+  virtual void toBinary(uint8_t* dest) const {
+    memcpy(dest, &temp, 4);
+    memcpy(dest + 4, &humidity, 4);
+    memcpy(dest + 8, &pressure, 4);
+    memcpy(dest + 12, &timestamp, 4);
+  }
+
+  virtual void fromBinary(const uint8_t* src) {
+    memcpy(&temp, src, 4);
+    memcpy(&humidity, src + 4, 4);
+    memcpy(&pressure, src + 8, 4);
+    memcpy(&timestamp, src + 12, 4);
+    calculateDerivedValues();
+  }
+
 };
 
 #endif // THPReadings.h
\ No newline at end of file
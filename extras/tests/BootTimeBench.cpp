@@ -0,0 +1,134 @@
+/*
+ * BootTimeBench
+ *     Host-side benchmark of the time it takes to bring up a 2000 element
+ *     history tier. It compares BPACircularBuffer's managed storage, which
+ *     starts out as raw memory, with the `new T[maxSize]` storage it replaced,
+ *     where every slot is default constructed up front and destroyed at the end.
+ *
+ * NOTES:
+ * o This isn't an Arduino sketch. Build and run it on Linux (or macOS) with:
+ *     g++ -std=gnu++11 -O2 -I ../../src BootTimeBench.cpp ../../src/BPAAllocator.cpp -o BootTimeBench
+ *     ./BootTimeBench [tier size]
+ * o The old storage is reproduced by handing the buffer a `new T[maxSize]`
+ *   array, which it then assigns into, just as it used to.
+ * o Two item types are timed: one shaped like THPReadings (a vtable, derived
+ *   values, and a constructor that marks the reading as empty), and a trivially
+ *   copyable one that takes the memcpy path.
+ * o Each case is timed for an empty tier (first boot) and for a tier that is
+ *   restored full from a saved history. The exit status is non-zero if the two
+ *   kinds of storage don't end up with the same contents.
+ *
+ */
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+//                                  Local Includes
+#include "BPACircularBuffer.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+// Shaped like THPReadings: a Serializable with derived values
+class Reading {
+public:
+  float     temp = -1000;       // A value < -500 implies no data is available
+  float     humidity = -1;
+  float     pressure = -1;
+  double    dewPointTemp = -1000;
+  float     dewPointSpread = -1000;
+  float     heatIndex = -1000;
+  uint32_t  timestamp = 0;
+
+  Reading() = default;
+  Reading(float t, float h, float p, uint32_t ts) : temp(t), humidity(h), pressure(p), timestamp(ts) {
+    dewPointTemp = t - (100 - h) / 5;
+    dewPointSpread = t - dewPointTemp;
+    heatIndex = t;
+  }
+  virtual ~Reading() { }
+
+  virtual uint32_t time() const { return timestamp; }
+};
+
+struct PlainReading {
+  float temp;
+  float humidity;
+  float pressure;
+  uint32_t timestamp;
+};
+
+static size_t errors = 0;
+static volatile uint32_t sink;   // Keeps the compiler from discarding the work
+
+// Run f repeatedly for about a quarter of a second. Returns microseconds per run.
+template<typename F>
+double timePerRun(F f) {
+  using Clock = std::chrono::steady_clock;
+  size_t reps = 0;
+  auto start = Clock::now();
+  auto end = start + std::chrono::milliseconds(250);
+  Clock::time_point now;
+  do { f(); reps++; } while ((now = Clock::now()) < end);
+  return std::chrono::duration<double, std::micro>(now - start).count() / reps;
+}
+
+static void report(const char* what, double before, double after) {
+  printf("  %-30s %9.2f us %9.2f us %7.1fx\n", what, before, after, before / after);
+}
+
+template<typename T>
+void bench(const char* name, size_t size, const std::vector<T>& saved) {
+  char title[64];
+  snprintf(title, sizeof(title), "%s, %zu items", name, size);
+  printf("%-32s %15s %12s  speedup\n", title, "new T[] storage", "raw storage");
+
+  // First boot: nothing to restore, the tier is set up and later torn down
+  double before = timePerRun([&]() {
+    T* space = new T[size];
+    BPACircularBuffer<T> tier(space, size);
+    sink = tier.capacity();
+    delete[] space;
+  });
+  double after = timePerRun([&]() {
+    BPACircularBuffer<T> tier(size);
+    sink = tier.capacity();
+  });
+  report("empty tier", before, after);
+
+  // Restart: the tier is filled from the saved history
+  uint32_t checkBefore = 0, checkAfter = 0;
+  before = timePerRun([&]() {
+    T* space = new T[size];
+    BPACircularBuffer<T> tier(space, size);
+    for (const T& item : saved) tier.push(item);
+    checkBefore = tier.peekAt(size / 2).timestamp + tier.last().timestamp;
+    delete[] space;
+  });
+  after = timePerRun([&]() {
+    BPACircularBuffer<T> tier(size);
+    for (const T& item : saved) tier.push(item);
+    checkAfter = tier.peekAt(size / 2).timestamp + tier.last().timestamp;
+  });
+  report("tier restored with push", before, after);
+  if (checkBefore != checkAfter) { errors++; printf("  MISMATCH: %u vs %u\n", checkBefore, checkAfter); }
+}
+
+int main(int argc, char** argv) {
+  size_t size = (argc > 1) ? atoi(argv[1]) : 2000;
+
+  std::vector<Reading> readings;
+  std::vector<PlainReading> plain;
+  for (size_t i = 0; i < size; i++) {
+    uint32_t ts = 1600000000 + i * 60;
+    readings.push_back(Reading(20 + (i % 10), 40 + (i % 7), 1010 + (i % 5), ts));
+    plain.push_back({ 20.0f + (i % 10), 40.0f + (i % 7), 1010.0f + (i % 5), ts });
+  }
+
+  bench("THPReadings-like", size, readings);
+  bench("Trivially copyable", size, plain);
+  puts(errors ? "FAILED" : "PASSED");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * BulkOpsBench
+ *     Host-side benchmark of the bulk operations of BPACircularBuffer and
+ *     BPAFixedSizeBuffer (pushMany, unshiftMany, copyOut, drainInto) against
+ *     the per-element loops they replace, e.g. restoring a history at boot
+ *     or moving a burst of sensor readings.
+ *
+ * NOTES:
+ * o This isn't an Arduino sketch. Build and run it on Linux (or macOS) with:
+ *     g++ -std=gnu++11 -O2 -I ../../src BulkOpsBench.cpp ../../src/BPAAllocator.cpp -o BulkOpsBench
+ *     ./BulkOpsBench [buffer size]
+ * o The items are a trivially copyable struct the size of a typical reading,
+ *   so the bulk operations take their memcpy path. The ring buffers start part
+ *   of the way around so that every bulk copy wraps.
+ * o Each bulk result is checked against the per-element loop. The exit status
+ *   is non-zero if they differ.
+ *
+ */
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+//                                  Local Includes
+#include "BPACircularBuffer.h"
+#include "BPAFixedSizeBuffer.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+struct Reading {
+  float temp;
+  float humidity;
+  float pressure;
+  uint32_t timestamp;
+};
+
+static size_t errors = 0;
+static volatile uint32_t sink;   // Keeps the compiler from discarding the work
+
+// Run f repeatedly for about a quarter of a second. Returns ns per element.
+template<typename F>
+double timePerElement(size_t nElements, F f) {
+  using Clock = std::chrono::steady_clock;
+  size_t reps = 0;
+  auto start = Clock::now();
+  auto end = start + std::chrono::milliseconds(250);
+  Clock::time_point now;
+  do { f(); reps++; } while ((now = Clock::now()) < end);
+  return std::chrono::duration<double, std::nano>(now - start).count() / (reps * nElements);
+}
+
+static void report(const char* what, double loop, double bulk) {
+  printf("  %-26s %8.2f ns/item %8.2f ns/item %7.1fx\n", what, loop, bulk, loop / bulk);
+}
+
+static bool same(const Reading& a, const Reading& b) {
+  return a.temp == b.temp && a.humidity == b.humidity && a.pressure == b.pressure && a.timestamp == b.timestamp;
+}
+
+static void check(bool ok, const char* what) {
+  if (!ok) { errors++; printf("  MISMATCH: %s\n", what); }
+}
+
+// Set up buffer with its first element part of the way around the ring
+template<typename Buffer>
+void offset(Buffer& buffer, size_t n) {
+  buffer.clear();
+  for (size_t i = 0; i < n; i++) buffer.push(Reading());
+  for (size_t i = 0; i < n; i++) buffer.shift();
+}
+
+void benchCircular(size_t size) {
+  BPACircularBuffer<Reading> a(size), b(size);
+  std::vector<Reading> items(size), out(size), outLoop(size);
+  for (size_t i = 0; i < size; i++) items[i] = { i * 0.5f, i * 0.25f, 1000.0f + i, static_cast<uint32_t>(i) };
+  bpa::span<const Reading> all(items.data(), size);
+  size_t skew = size / 3;
+
+  printf("BPACircularBuffer, %zu items        per-element         bulk  speedup\n", size);
+
+  // Once full, each push overwrites the oldest item, so the buffers don't need
+  // to be emptied between repetitions
+  offset(a, skew);
+  offset(b, skew);
+  double loop = timePerElement(size, [&]() { for (const Reading& r : items) a.push(r); });
+  double bulk = timePerElement(size, [&]() { b.pushMany(all); });
+  report("push vs pushMany", loop, bulk);
+  for (size_t i = 0; i < size; i++) check(same(a.peekAt(i), b.peekAt(i)), "pushMany");
+
+  loop = timePerElement(size, [&]() { for (size_t i = size; i-- > 0; ) a.unshift(items[i]); });
+  bulk = timePerElement(size, [&]() { b.unshiftMany(all); });
+  report("unshift vs unshiftMany", loop, bulk);
+  for (size_t i = 0; i < size; i++) check(same(a.peekAt(i), b.peekAt(i)), "unshiftMany");
+
+  loop = timePerElement(size, [&]() { for (size_t i = 0; i < size; i++) outLoop[i] = a.peekAt(i); sink = outLoop[size / 2].timestamp; });
+  bulk = timePerElement(size, [&]() { b.copyOut(bpa::span<Reading>(out.data(), size)); sink = out[size / 2].timestamp; });
+  report("peekAt vs copyOut", loop, bulk);
+  for (size_t i = 0; i < size; i++) check(same(out[i], outLoop[i]), "copyOut");
+
+  // Both refill with pushMany, which is included in the time
+  loop = timePerElement(size, [&]() {
+    a.pushMany(all);
+    for (size_t i = 0; i < size; i++) outLoop[i] = a.shift();
+  });
+  bulk = timePerElement(size, [&]() {
+    b.pushMany(all);
+    b.drainInto(bpa::span<Reading>(out.data(), size));
+  });
+  report("shift vs drainInto (+fill)", loop, bulk);
+  for (size_t i = 0; i < size; i++) check(same(out[i], outLoop[i]), "drainInto");
+}
+
+void benchFixed(size_t size) {
+  BPAFixedSizeBuffer<Reading> a(size), b(size);
+  std::vector<Reading> items(size), out(size), outLoop(size);
+  for (size_t i = 0; i < size; i++) items[i] = { i * 0.5f, i * 0.25f, 1000.0f + i, static_cast<uint32_t>(i) };
+  bpa::span<const Reading> all(items.data(), size);
+
+  printf("BPAFixedSizeBuffer, %zu items       per-element         bulk  speedup\n", size);
+
+  double loop = timePerElement(size, [&]() { a.clear(); for (const Reading& r : items) a.push(r); });
+  double bulk = timePerElement(size, [&]() { b.clear(); b.pushMany(all); });
+  report("push vs pushMany", loop, bulk);
+  for (size_t i = 0; i < size; i++) check(same(a.peekAt(i), b.peekAt(i)), "pushMany");
+
+  loop = timePerElement(size, [&]() { for (size_t i = 0; i < size; i++) outLoop[i] = a.peekAt(i); sink = outLoop[size / 2].timestamp; });
+  bulk = timePerElement(size, [&]() { b.copyOut(bpa::span<Reading>(out.data(), size)); sink = out[size / 2].timestamp; });
+  report("peekAt vs copyOut", loop, bulk);
+  for (size_t i = 0; i < size; i++) check(same(out[i], outLoop[i]), "copyOut");
+}
+
+int main(int argc, char** argv) {
+  size_t size = (argc > 1) ? atoi(argv[1]) : 2000;
+  benchCircular(size);
+  benchFixed(size);
+  puts(errors ? "FAILED" : "PASSED");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * DispatchBench
+ *     Host-side benchmark of the two ways HistoryBuffer's items can be
+ *     stored. HistoryBufferBase's fallback loops make virtual calls to
+ *     peekAt() and to the item's functions for every item. HistoryBuffer's
+ *     overrides know the item type and make direct calls instead, leaving one
+ *     virtual call per store. Both are timed for JSON (storeItems) and for
+ *     binary records (storeRecords).
+ *
+ * NOTES:
+ * o This isn't an Arduino sketch. It builds on Linux (or macOS) against the
+ *   stand-ins for the Arduino core in extras/tests/host and a copy of
+ *   ArduinoJson 6 (e.g. the one in your Arduino libraries folder):
+ *     g++ -std=gnu++11 -O2 -DARDUINOJSON_ENABLE_ARDUINO_STREAM=1 -DARDUINOJSON_ENABLE_ARDUINO_PRINT=1 \
+ *         -I host -I ../../src -I ../../examples/HBTest -I <ArduinoJson>/src DispatchBench.cpp host/Host.cpp \
+ *         ../../src/BPAAllocator.cpp ../../src/BufferedWriteStream.cpp ../../src/JsonWriter.cpp \
+ *         ../../src/JsonStreamReader.cpp ../../src/HistoryBinary.cpp ../../src/HistoryOutputCache.cpp \
+ *         -o DispatchBench
+ *     ./DispatchBench [items]
+ * o The items are the THPReadings from the HBTest example. JSON goes to a
+ *   stream that only checksums it, so the time is spent producing it.
+ * o The two paths must produce identical output. The exit status is non-zero
+ *   if they don't.
+ *
+ */
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+//                                  Third Party Libraries
+#include <ArduinoJson.h>
+//                                  Local Includes
+#include "HistoryBuffer.h"
+#include "THPReadings.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+// Discards what is written, keeping a checksum so the paths can be compared
+class ChecksumStream : public Stream {
+public:
+  virtual size_t write(uint8_t c) override { sum = sum * 31 + c; return 1; }
+  virtual size_t write(const uint8_t* buffer, size_t size) override {
+    for (size_t i = 0; i < size; i++) sum = sum * 31 + buffer[i];
+    return size;
+  }
+  virtual int available() override { return 0; }
+  virtual int read() override { return -1; }
+  virtual int peek() override { return -1; }
+
+  uint32_t sum = 0;
+};
+
+// Exposes both the base class's per item virtual loops and the overrides
+class BenchBuffer : public HistoryBuffer<THPReadings> {
+public:
+  using HistoryBuffer<THPReadings>::HistoryBuffer;
+
+  void storeVirtual(JsonWriter& writer) const { HistoryBufferBase::storeItems(writer); }
+  void storeDirect(JsonWriter& writer) const { storeItems(writer); }
+  void recordsVirtual(uint8_t* dest) const { HistoryBufferBase::storeRecords(0, size(), dest); }
+  void recordsDirect(uint8_t* dest) const { storeRecords(0, size(), dest); }
+};
+
+// Run f repeatedly for about half a second. Returns millions of items per second.
+template<typename F>
+double mItemsPerSecond(size_t nItems, F f) {
+  using Clock = std::chrono::steady_clock;
+  size_t reps = 0;
+  auto start = Clock::now();
+  auto end = start + std::chrono::milliseconds(500);
+  Clock::time_point now;
+  do { f(); reps++; } while ((now = Clock::now()) < end);
+  return reps * nItems / std::chrono::duration<double>(now - start).count() / 1e6;
+}
+
+static void report(const char* what, double virtualRate, double directRate) {
+  printf("  %-14s %12.2f %12.2f %7.2fx\n", what, virtualRate, directRate, directRate / virtualRate);
+}
+
+int main(int argc, char** argv) {
+  size_t nItems = (argc > 1) ? atoi(argv[1]) : 1000;
+
+  BenchBuffer history({ nItems, "history", 0 });
+  for (size_t i = 0; i < nItems; i++) {
+    THPReadings reading(18.0f + (i % 100) / 10.0f, 40.0f + (i % 37) / 2.0f, 1013.25f - (i % 50) / 4.0f);
+    reading.timestamp = 1600000000 + i * 60;
+    history.push(reading);
+  }
+
+  printf("Storing %zu THPReadings, M items/s\n", nItems);
+  printf("  %-14s %12s %12s  speedup\n", "", "virtual", "direct");
+
+  ChecksumStream virtualOut, directOut;
+  double virtualRate = mItemsPerSecond(nItems, [&]() { virtualOut.sum = 0; JsonWriter w(virtualOut); history.storeVirtual(w); });
+  double directRate = mItemsPerSecond(nItems, [&]() { directOut.sum = 0; JsonWriter w(directOut); history.storeDirect(w); });
+  report("JSON", virtualRate, directRate);
+  bool passed = (virtualOut.sum == directOut.sum);
+
+  std::vector<uint8_t> virtualRecords(nItems * history.itemBinarySize());
+  std::vector<uint8_t> directRecords(virtualRecords.size());
+  virtualRate = mItemsPerSecond(nItems, [&]() { history.recordsVirtual(virtualRecords.data()); });
+  directRate = mItemsPerSecond(nItems, [&]() { history.recordsDirect(directRecords.data()); });
+  report("binary records", virtualRate, directRate);
+  passed = passed && (virtualRecords == directRecords);
+
+  puts(passed ? "PASSED" : "FAILED");
+  return passed ? 0 : 1;
+}
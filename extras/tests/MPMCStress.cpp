@@ -0,0 +1,154 @@
+/*
+ * MPMCStress
+ *     Host-side stress test and contention benchmark for BPAMPMCBuffer.
+ *     Several producer threads push numbered items while one or more consumer
+ *     threads pop them. Every item must arrive intact and exactly once, and the
+ *     items from any one producer must reach any one consumer in order. The
+ *     same traffic is then run through a BPACircularBuffer guarded by a mutex,
+ *     which is what the lock-free queue replaces.
+ *
+ * NOTES:
+ * o This isn't an Arduino sketch. Build and run it on Linux (or macOS) with:
+ *     g++ -std=gnu++11 -O2 -pthread -I ../../src MPMCStress.cpp ../../src/BPAAllocator.cpp -o MPMCStress
+ *     ./MPMCStress [thousands of items per producer]
+ * o The benchmark runs 1, 2, 4, and 8 producers, first with a single consumer
+ *   (several tasks feeding loop()) and then with as many consumers as producers.
+ * o The exit status is non-zero if any check fails.
+ *
+ */
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+//                                  Local Includes
+#include "BPAMPMCBuffer.h"
+#include "BPACircularBuffer.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+struct Item {
+  uint32_t producer;
+  uint32_t n;
+  uint32_t check;     // A function of the other two, to catch torn copies
+};
+
+static inline uint32_t checkFor(uint32_t producer, uint32_t n) { return ~(n * 2654435761UL + producer); }
+
+static constexpr size_t QueueSize = 256;
+static constexpr int MaxThreads = 8;
+
+// The lock-based alternative: a BPACircularBuffer that only one thread touches at a time
+class MutexBuffer {
+public:
+  MutexBuffer() : _items(QueueSize) { }
+
+  bool tryPush(const Item& item) {
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_items.isFull()) return false;
+    _items.push(item);
+    return true;
+  }
+
+  bool tryPop(Item& item) {
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_items.isEmpty()) return false;
+    item = _items.shift();
+    return true;
+  }
+
+private:
+  std::mutex _lock;
+  BPACircularBuffer<Item> _items;
+};
+
+// Run nProducers producers and nConsumers consumers through queue. Returns the
+// number of errors found and sets seconds to the elapsed time.
+template<typename Queue>
+size_t run(Queue& queue, int nProducers, int nConsumers, uint32_t perProducer, double& seconds) {
+  size_t total = static_cast<size_t>(nProducers) * perProducer;
+  std::unique_ptr<std::atomic<uint8_t>[]> seen(new std::atomic<uint8_t>[total]);
+  for (size_t i = 0; i < total; i++) seen[i].store(0, std::memory_order_relaxed);
+  std::atomic<size_t> popped{0};
+  std::atomic<size_t> errors{0};
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < nProducers; p++) {
+    threads.emplace_back([&, p]() {
+      for (uint32_t n = 0; n < perProducer; n++) {
+        Item item = { static_cast<uint32_t>(p), n, checkFor(p, n) };
+        while (!queue.tryPush(item)) std::this_thread::yield();
+      }
+    });
+  }
+
+  for (int c = 0; c < nConsumers; c++) {
+    threads.emplace_back([&]() {
+      int64_t last[MaxThreads];
+      for (int p = 0; p < MaxThreads; p++) last[p] = -1;
+      Item item;
+      while (popped.load(std::memory_order_relaxed) < total) {
+        if (!queue.tryPop(item)) { std::this_thread::yield(); continue; }
+        popped.fetch_add(1, std::memory_order_relaxed);
+        if (item.producer >= static_cast<uint32_t>(nProducers) || item.n >= perProducer ||
+            item.check != checkFor(item.producer, item.n)) {
+          if (errors++ < 10) printf("  Torn item: producer %u, n %u\n", item.producer, item.n);
+          continue;
+        }
+        if (seen[item.producer * perProducer + item.n].fetch_add(1) != 0) {
+          if (errors++ < 10) printf("  Duplicate item: producer %u, n %u\n", item.producer, item.n);
+        }
+        if (static_cast<int64_t>(item.n) <= last[item.producer]) {
+          if (errors++ < 10) printf("  Out of order: producer %u, n %u\n", item.producer, item.n);
+        }
+        last[item.producer] = item.n;
+      }
+    });
+  }
+
+  for (std::thread& t : threads) t.join();
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (size_t i = 0; i < total; i++) {
+    if (seen[i].load() != 1 && errors++ < 10) printf("  Lost item: producer %zu, n %zu\n", i / perProducer, i % perProducer);
+  }
+  return errors;
+}
+
+int main(int argc, char** argv) {
+  uint32_t perProducer = (argc > 1) ? atof(argv[1]) * 1000 : 500000;
+  printf("%u items per producer through a %zu item queue on %u hardware threads\n",
+      perProducer, QueueSize, std::thread::hardware_concurrency());
+  printf("Producers  Consumers  BPAMPMCBuffer (M items/s)  BPACircularBuffer + mutex (M items/s)\n");
+
+  BPAMPMCBuffer<Item>::Slot slots[QueueSize];
+  size_t errors = 0;
+  for (int nConsumers : { 1, 0 }) {
+    for (int nProducers = 1; nProducers <= MaxThreads; nProducers *= 2) {
+      int consumers = nConsumers ? nConsumers : nProducers;
+      double lockFree, locked;
+
+      BPAMPMCBuffer<Item> queue(slots, QueueSize);
+      errors += run(queue, nProducers, consumers, perProducer, lockFree);
+      errors += queue.isEmpty() ? 0 : 1;
+
+      MutexBuffer guarded;
+      errors += run(guarded, nProducers, consumers, perProducer, locked);
+
+      double nItems = static_cast<double>(nProducers) * perProducer / 1e6;
+      printf("%9d  %9d  %25.2f  %37.2f\n", nProducers, consumers, nItems / lockFree, nItems / locked);
+    }
+  }
+
+  printf("%zu errors\n", errors);
+  puts(errors ? "FAILED" : "PASSED");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * SeqLockStress
+ *     Host-side stress test and throughput benchmark for BPASeqLock, the
+ *     sequence lock behind ConcurrentHistoryBuffer. A writer thread pushes into
+ *     a BPACircularBuffer while reader threads take snapshots of it, the same
+ *     way ConcurrentHistoryBuffer does, and check every snapshot for tearing.
+ *
+ * NOTES:
+ * o This isn't an Arduino sketch. Build and run it on Linux (or macOS) with:
+ *     g++ -std=gnu++11 -O2 -pthread -I ../../src SeqLockStress.cpp ../../src/BPAAllocator.cpp -o SeqLockStress
+ *     ./SeqLockStress [seconds] [readers]
+ * o Every field of an item is derived from one counter, and consecutive items
+ *   have consecutive counters, so a snapshot that mixes items from before and
+ *   after a write, or that catches an item half written, is detected.
+ * o The writer runs alone first and then with the readers, so the report shows
+ *   what the readers cost it. Snapshots that gave up after too many retries are
+ *   counted separately; they are not errors.
+ * o The exit status is non-zero if any snapshot was torn.
+ *
+ */
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+//                                  Local Includes
+#include "BPACircularBuffer.h"
+#include "BPASeqLock.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+struct Item {
+  uint32_t n;
+  uint32_t twice;
+  uint32_t complement;
+  float half;
+};
+
+static constexpr size_t HistorySize = 256;
+static constexpr size_t SnapshotSize = 100;
+
+static BPACircularBuffer<Item> history(HistorySize);
+static BPASeqLock lock;
+static std::atomic<bool> running{false};
+static std::atomic<size_t> snapshots{0};
+static std::atomic<size_t> gaveUp{0};
+static std::atomic<size_t> torn{0};
+
+static bool consistent(const Item& item) {
+  return item.twice == item.n * 2 && item.complement == ~item.n && item.half == item.n / 2.0f;
+}
+
+static void reader(int id) {
+  Item copy[SnapshotSize];
+  size_t mine = 0;
+  while (running.load(std::memory_order_relaxed)) {
+    // Alternate between the newest items and a range in the middle
+    bool newest = (mine + id) & 1;
+    size_t n = lock.snapshot(history, HistorySize / 4, SnapshotSize, copy, newest);
+    if (n == 0) gaveUp++;
+    for (size_t i = 0; i < n; i++) {
+      if (!consistent(copy[i]) || (i && copy[i].n != copy[i-1].n + 1)) {
+        if (torn++ < 10) printf("  Torn snapshot: item %zu is %u after %u\n", i, copy[i].n, i ? copy[i-1].n : 0);
+        break;
+      }
+    }
+    mine++;
+  }
+  snapshots += mine;
+}
+
+// Push for the given number of seconds. Returns the number of pushes.
+static size_t pushFor(double seconds, uint32_t& counter) {
+  size_t pushes = 0;
+  auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    for (int i = 0; i < 1000; i++) {
+      // Keep the counter small enough for half to stay exact
+      if (++counter == (1UL << 22)) {
+        counter = 0;
+        lock.beginWrite();
+        history.clear();
+        lock.endWrite();
+      }
+      Item item = { counter, counter * 2, ~counter, counter / 2.0f };
+      lock.beginWrite();
+      history.push(item);
+      lock.endWrite();
+    }
+    pushes += 1000;
+  }
+  return pushes;
+}
+
+int main(int argc, char** argv) {
+  double seconds = (argc > 1) ? atof(argv[1]) : 5;
+  int nReaders = (argc > 2) ? atoi(argv[2]) : 3;
+  printf("1 writer and %d readers for %.1f seconds on %u hardware threads\n",
+      nReaders, seconds, std::thread::hardware_concurrency());
+
+  uint32_t counter = 0;
+  double solo = pushFor(1, counter);
+
+  running = true;
+  std::vector<std::thread> readers;
+  for (int i = 0; i < nReaders; i++) readers.emplace_back(reader, i);
+  double shared = pushFor(seconds, counter);
+  running = false;
+  for (std::thread& t : readers) t.join();
+
+  printf("Writer alone:          %7.2f M pushes/s\n", solo / 1e6);
+  printf("Writer with readers:   %7.2f M pushes/s\n", shared / seconds / 1e6);
+  printf("Readers:               %7.2f M snapshots/s of %zu items, %zu gave up\n",
+      snapshots / seconds / 1e6, SnapshotSize, gaveUp.load());
+  printf("%zu torn snapshots\n", torn.load());
+  puts(torn ? "FAILED" : "PASSED");
+  return torn ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * StoreBench
+ *     Host-side benchmark of HistoryBuffer::store(). It compares the way a
+ *     history used to be written, with each item serializing its own
+ *     JsonDocument straight to the file, with the current path, where items
+ *     write their fields through a JsonWriter into a StaticBufferedWriteStream.
+ *     It reports items per second and the number of write calls that reach
+ *     the file.
+ *
+ * NOTES:
+ * o This isn't an Arduino sketch. It builds on Linux (or macOS) against the
+ *   stand-ins for the Arduino core in extras/tests/host and a copy of
+ *   ArduinoJson 6 (e.g. the one in your Arduino libraries folder):
+ *     g++ -std=gnu++11 -O2 -DARDUINOJSON_ENABLE_ARDUINO_STREAM=1 -DARDUINOJSON_ENABLE_ARDUINO_PRINT=1 \
+ *         -I host -I ../../src -I ../../examples/HBTest -I <ArduinoJson>/src StoreBench.cpp host/Host.cpp \
+ *         ../../src/BPAAllocator.cpp ../../src/BufferedWriteStream.cpp ../../src/JsonWriter.cpp \
+ *         ../../src/JsonStreamReader.cpp ../../src/HistoryBinary.cpp ../../src/HistoryOutputCache.cpp \
+ *         -o StoreBench
+ *     ./StoreBench [items]
+ * o The items are the THPReadings from the HBTest example. The file is a
+ *   stream that keeps what is written to it and counts the calls, each of
+ *   which would be a separate trip into the file system on a device.
+ * o Both outputs are loaded back into a HistoryBuffer. The exit status is
+ *   non-zero if either fails to load or holds the wrong number of items.
+ *
+ */
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+//                                  Third Party Libraries
+#include <ArduinoJson.h>
+//                                  Local Includes
+#include "HistoryBuffer.h"
+#include "THPReadings.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+// Stands in for a file: keeps what is written and counts the write calls
+class CountingFile : public Stream {
+public:
+  virtual size_t write(uint8_t c) override { writeCalls++; contents += static_cast<char>(c); return 1; }
+  virtual size_t write(const uint8_t* buffer, size_t size) override {
+    writeCalls++;
+    contents.append(reinterpret_cast<const char*>(buffer), size);
+    return size;
+  }
+  virtual int available() override { return contents.size() - readPos; }
+  virtual int read() override { return (readPos < contents.size()) ? static_cast<uint8_t>(contents[readPos++]) : -1; }
+  virtual int peek() override { return (readPos < contents.size()) ? static_cast<uint8_t>(contents[readPos]) : -1; }
+
+  void reset() { contents.clear(); readPos = 0; writeCalls = 0; }
+
+  std::string contents;
+  size_t readPos = 0;
+  size_t writeCalls = 0;
+};
+
+// The store loop as it was: one JsonDocument per item, written unbuffered
+void storeUnbuffered(const HistoryBuffer<THPReadings>& history, Stream& file) {
+  file.print("{ \"history\": [");
+  for (size_t i = 0; i < history.size(); i++) {
+    if (i) file.print(',');
+    history.peekAt(i).externalize(file);
+  }
+  file.println("]}");
+  file.flush();
+}
+
+// The store loop as it is: JsonWriter into a buffer in front of the file
+void storeBuffered(const HistoryBuffer<THPReadings>& history, Stream& file) {
+  StaticBufferedWriteStream<> bufferedFile(file);
+  history.store(bufferedFile);
+  bufferedFile.flush();
+}
+
+// Time repeated stores for about a second. Returns items per second and
+// leaves the output of the last store in file.
+template<typename F>
+double itemsPerSecond(size_t nItems, CountingFile& file, F store) {
+  using Clock = std::chrono::steady_clock;
+  size_t reps = 0;
+  auto start = Clock::now();
+  auto end = start + std::chrono::seconds(1);
+  Clock::time_point now;
+  do { file.reset(); store(file); reps++; } while ((now = Clock::now()) < end);
+  return reps * nItems / std::chrono::duration<double>(now - start).count();
+}
+
+bool loadsBack(CountingFile& file, size_t nItems) {
+  HistoryBuffer<THPReadings> loaded({ nItems, "loaded", 0 });
+  file.readPos = 0;
+  return loaded.load(file) && loaded.size() == nItems;
+}
+
+int main(int argc, char** argv) {
+  size_t nItems = (argc > 1) ? atoi(argv[1]) : 1000;
+
+  HistoryBuffer<THPReadings> history({ nItems, "history", 0 });
+  for (size_t i = 0; i < nItems; i++) {
+    THPReadings reading(18.0f + (i % 100) / 10.0f, 40.0f + (i % 37) / 2.0f, 1013.25f - (i % 50) / 4.0f);
+    reading.timestamp = 1600000000 + i * 60;
+    history.push(reading);
+  }
+
+  CountingFile before, after;
+  double beforeRate = itemsPerSecond(nItems, before, [&](Stream& file) { storeUnbuffered(history, file); });
+  double afterRate = itemsPerSecond(nItems, after, [&](Stream& file) { storeBuffered(history, file); });
+
+  printf("Storing %zu THPReadings      items/s  write calls     bytes\n", nItems);
+  printf("  JsonDocument, unbuffered %10.0f %12zu %9zu\n", beforeRate, before.writeCalls, before.contents.size());
+  printf("  JsonWriter, buffered     %10.0f %12zu %9zu\n", afterRate, after.writeCalls, after.contents.size());
+  printf("  %.1fx the items/s, %.0fx fewer write calls\n",
+      afterRate / beforeRate, static_cast<double>(before.writeCalls) / after.writeCalls);
+
+  bool passed = loadsBack(before, nItems) && loadsBack(after, nItems);
+  puts(passed ? "PASSED" : "FAILED");
+  return passed ? 0 : 1;
+}
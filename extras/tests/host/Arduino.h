@@ -0,0 +1,110 @@
+/*
+ * Arduino.h (host)
+ *     Just enough of the Arduino core to build the history benchmarks on a
+ *     desktop machine: Print, Stream, a minimal String, and the timing calls.
+ *
+ * NOTES:
+ * o Only for the host tests in extras/tests. Sketches use the real core.
+ * o ARDUINO is deliberately left undefined, so ArduinoJson must be told to
+ *   use Print and Stream (see the build lines in the benchmarks).
+ *
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+typedef uint8_t byte;
+
+#define F(s) (s)
+#define CR "\n"
+
+inline uint32_t millis() {
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline long random(long howBig) { return howBig ? rand() % howBig : 0; }
+inline long random(long howSmall, long howBig) { return howSmall + random(howBig - howSmall); }
+
+inline void yield() { std::this_thread::yield(); }
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+class String {
+public:
+  String(const char* s = "") : _s(s ? s : "") { }
+  const char* c_str() const { return _s.c_str(); }
+  size_t length() const { return _s.size(); }
+  bool operator==(const String& other) const { return _s == other._s; }
+  bool operator!=(const String& other) const { return _s != other._s; }
+  String operator+(const String& other) const { String s(*this); s._s += other._s; return s; }
+private:
+  std::string _s;
+};
+
+class Print {
+public:
+  virtual ~Print() { }
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size-- && write(*buffer++)) n++;
+    return n;
+  }
+  size_t write(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+  size_t write(const char* buffer, size_t size) { return write(reinterpret_cast<const uint8_t*>(buffer), size); }
+  virtual void flush() { }
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write(s.c_str()); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int n) { return printFormatted("%d", n); }
+  size_t print(unsigned n) { return printFormatted("%u", n); }
+  size_t print(long n) { return printFormatted("%ld", n); }
+  size_t print(unsigned long n) { return printFormatted("%lu", n); }
+  size_t print(double n, int digits = 2) { return printFormatted("%.*f", digits, n); }
+  size_t println(const char* s) { return print(s) + write("\r\n"); }
+  size_t println() { return write("\r\n"); }
+
+  int getWriteError() { return _writeError; }
+  void clearWriteError() { _writeError = 0; }
+
+protected:
+  void setWriteError(int err = 1) { _writeError = err; }
+
+private:
+  template<typename... Args>
+  size_t printFormatted(const char* format, Args... args) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), format, args...);
+    return write(buf, n);
+  }
+
+  int _writeError = 0;
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    int c;
+    while (n < length && (c = read()) >= 0) buffer[n++] = static_cast<char>(c);
+    return n;
+  }
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes(reinterpret_cast<char*>(buffer), length); }
+};
+
+#endif  // Arduino_h
@@ -0,0 +1,27 @@
+/*
+ * ArduinoLog.h (host)
+ *     A silent stand-in for the ArduinoLog library, for the host tests in
+ *     extras/tests.
+ *
+ */
+
+#ifndef ArduinoLog_h
+#define ArduinoLog_h
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_SILENT  0
+#define LOG_LEVEL_VERBOSE 6
+
+class Logging {
+public:
+  template<typename... Args> void error(Args...) { }
+  template<typename... Args> void warning(Args...) { }
+  template<typename... Args> void notice(Args...) { }
+  template<typename... Args> void trace(Args...) { }
+  template<typename... Args> void verbose(Args...) { }
+};
+
+extern Logging Log;
+
+#endif  // ArduinoLog_h
@@ -0,0 +1,30 @@
+/*
+ * FS.h (host)
+ *     Declares the File type that ESP_FS.h refers to. The host tests write to
+ *     their own streams, so no File is ever opened.
+ *
+ */
+
+#ifndef FS_h
+#define FS_h
+
+#include <Arduino.h>
+
+class File : public Stream {
+public:
+  explicit operator bool() const { return false; }
+  virtual size_t write(uint8_t) override { return 0; }
+  virtual size_t write(const uint8_t*, size_t) override { return 0; }
+  virtual int available() override { return 0; }
+  virtual int read() override { return -1; }
+  virtual int peek() override { return -1; }
+  size_t read(uint8_t*, size_t) { return 0; }
+  size_t size() const { return 0; }
+  size_t position() const { return 0; }
+  bool seek(size_t) { return false; }
+  void close() { }
+};
+
+class FS { };
+
+#endif  // FS_h
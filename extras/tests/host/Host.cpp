@@ -0,0 +1,9 @@
+/*
+ * Host.cpp
+ *     Definitions behind the stand-ins in this directory.
+ *
+ */
+
+#include <ArduinoLog.h>
+
+Logging Log;
@@ -0,0 +1,144 @@
+/*
+ * BPAAllocator
+ *    Implementation of the heap, arena, and pool allocators
+ *
+ */
+
+#include <stdlib.h>
+#include <cstddef>
+#include "BPAAllocator.h"
+
+namespace {
+  // Every block the allocators hand out is aligned at least this well
+  constexpr size_t MaxAlign = alignof(std::max_align_t);
+
+  inline uintptr_t alignUp(uintptr_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+  }
+};
+
+
+//
+// ----- BPAAllocator
+//
+
+BPAAllocator& BPAAllocator::heap() {
+  static BPAHeapAllocator theHeap;
+  return theHeap;
+}
+
+
+//
+// ----- BPAHeapAllocator
+//
+
+void* BPAHeapAllocator::allocate(size_t size, size_t alignment) {
+  if (alignment > MaxAlign) return nullptr;   // malloc can't promise more than this
+  return malloc(size ? size : 1);
+}
+
+void BPAHeapAllocator::deallocate(void* p, size_t, size_t) {
+  free(p);
+}
+
+
+//
+// ----- BPAArenaAllocator
+//
+
+BPAArenaAllocator::~BPAArenaAllocator() {
+  if (_ownsRegion) free(_region);
+}
+
+void BPAArenaAllocator::init(void* region, size_t size) {
+  if (_ownsRegion) free(_region);
+  _region = static_cast<uint8_t*>(region);
+  _size = region ? size : 0;
+  _used = _highWater = 0;
+  _nFailed = 0;
+  _ownsRegion = false;
+}
+
+bool BPAArenaAllocator::init(size_t size) {
+  void* region = malloc(size);
+  init(region, size);
+  _ownsRegion = (region != nullptr);
+  return _ownsRegion;
+}
+
+void* BPAArenaAllocator::allocate(size_t size, size_t alignment) {
+  uintptr_t base = reinterpret_cast<uintptr_t>(_region);
+  size_t start = alignUp(base + _used, alignment) - base;
+  if (_region == nullptr || start > _size || size > _size - start) {
+    _nFailed++;
+    return nullptr;
+  }
+  _used = start + size;
+  if (_used > _highWater) _highWater = _used;
+  return _region + start;
+}
+
+void BPAArenaAllocator::deallocate(void* p, size_t size, size_t) {
+  uint8_t* block = static_cast<uint8_t*>(p);
+  if (block + size == _region + _used) _used = block - _region;
+}
+
+
+//
+// ----- BPAPoolAllocator
+//
+
+BPAPoolAllocator::~BPAPoolAllocator() {
+  if (_ownsRegion) free(_region);
+}
+
+void BPAPoolAllocator::init(void* region, size_t size, size_t blockSize) {
+  if (_ownsRegion) free(_region);
+  _ownsRegion = false;
+  _region = static_cast<uint8_t*>(region);
+  _freeList = nullptr;
+  _inUse = _highWater = 0;
+  _nFailed = 0;
+
+  // Round the block size up so that every block starts on a MaxAlign boundary
+  _blockSize = alignUp(blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : blockSize, MaxAlign);
+  uintptr_t base = reinterpret_cast<uintptr_t>(region);
+  size_t skip = alignUp(base, MaxAlign) - base;
+  _nBlocks = (region && size > skip) ? (size - skip) / _blockSize : 0;
+
+  // Thread the free list through the blocks so they are handed out in address order
+  uint8_t* first = _region + skip;
+  for (size_t i = _nBlocks; i-- > 0; ) {
+    FreeBlock* block = reinterpret_cast<FreeBlock*>(first + i * _blockSize);
+    block->next = _freeList;
+    _freeList = block;
+  }
+}
+
+bool BPAPoolAllocator::init(size_t nBlocks, size_t blockSize) {
+  size_t rounded = alignUp(blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : blockSize, MaxAlign);
+  size_t size = nBlocks * rounded;
+  void* region = malloc(size);   // malloc's result is already MaxAlign aligned
+  init(region, size, blockSize);
+  _ownsRegion = (region != nullptr);
+  return _ownsRegion;
+}
+
+void* BPAPoolAllocator::allocate(size_t size, size_t alignment) {
+  if (size > _blockSize || alignment > MaxAlign || _freeList == nullptr) {
+    _nFailed++;
+    return nullptr;
+  }
+  FreeBlock* block = _freeList;
+  _freeList = block->next;
+  if (++_inUse > _highWater) _highWater = _inUse;
+  return block;
+}
+
+void BPAPoolAllocator::deallocate(void* p, size_t, size_t) {
+  if (p == nullptr) return;
+  FreeBlock* block = static_cast<FreeBlock*>(p);
+  block->next = _freeList;
+  _freeList = block;
+  _inUse--;
+}
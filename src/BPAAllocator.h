@@ -0,0 +1,130 @@
+/*
+ * BPAAllocator
+ *    A minimal allocator interface used by the buffer templates when they manage
+ *    their own storage, along with three implementations:
+ *    o BPAHeapAllocator: Plain malloc/free. This is the default.
+ *    o BPAArenaAllocator: A bump-pointer arena over one region of memory. Ideal for
+ *      long-lived buffers that are created at startup and never freed.
+ *    o BPAPoolAllocator: A pool of equal sized blocks carved out of one region.
+ *      Useful when buffers of similar size come and go.
+ *
+ * NOTES:
+ * o The point of the arena and the pool is to avoid scattering many long-lived
+ *   blocks around the heap. On an ESP8266 that fragmentation is what eventually
+ *   makes large allocations fail (see GenericESP::getHeapFragmentation).
+ * o allocate() returns nullptr when it can't satisfy a request. It never throws.
+ * o The allocators are not thread safe. They are meant for setup-time allocation.
+ *
+ * Usage:
+ *   BPAArenaAllocator historyArena;
+ *   historyArena.init(8192);                       // One heap block for all histories
+ *   buffers.describe({12, "hour", 300}, historyArena);
+ *   buffers.describe({24, "day", 3600}, historyArena);
+ *   Log.verbose("Arena high-water: %d", historyArena.highWaterMark());
+ *
+ */
+
+#ifndef BPAAllocator_h
+#define BPAAllocator_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+class BPAAllocator {
+public:
+  virtual ~BPAAllocator() {}
+
+  virtual void* allocate(size_t size, size_t alignment) = 0;
+  virtual void deallocate(void* p, size_t size, size_t alignment) = 0;
+
+  // The allocator used when none is specified
+  static BPAAllocator& heap();
+};
+
+
+class BPAHeapAllocator : public BPAAllocator {
+public:
+  virtual void* allocate(size_t size, size_t alignment) override;
+  virtual void deallocate(void* p, size_t size, size_t alignment) override;
+};
+
+
+class BPAArenaAllocator : public BPAAllocator {
+public:
+  BPAArenaAllocator() = default;
+  BPAArenaAllocator(void* region, size_t size) { init(region, size); }
+  ~BPAArenaAllocator();
+
+  // Carve allocations out of a region provided by the caller
+  void init(void* region, size_t size);
+
+  // Allocate the region from the heap in one piece. Returns false if that fails.
+  bool init(size_t size);
+
+  virtual void* allocate(size_t size, size_t alignment) override;
+
+  // Memory is only reclaimed if p was the most recent allocation. Otherwise
+  // it is reclaimed by reset().
+  virtual void deallocate(void* p, size_t size, size_t alignment) override;
+
+  // Forget every allocation. The caller must be done with all of them.
+  void reset() { _used = 0; }
+
+  size_t capacity() const { return _size; }
+  size_t used() const { return _used; }
+  size_t available() const { return _size - _used; }
+  size_t highWaterMark() const { return _highWater; }
+  uint16_t failedAllocations() const { return _nFailed; }
+
+  BPAArenaAllocator(const BPAArenaAllocator&) = delete;
+  BPAArenaAllocator& operator=(const BPAArenaAllocator&) = delete;
+
+private:
+  uint8_t* _region = nullptr;
+  size_t _size = 0;
+  size_t _used = 0;
+  size_t _highWater = 0;
+  uint16_t _nFailed = 0;
+  bool _ownsRegion = false;
+};
+
+
+class BPAPoolAllocator : public BPAAllocator {
+public:
+  BPAPoolAllocator() = default;
+  BPAPoolAllocator(void* region, size_t size, size_t blockSize) { init(region, size, blockSize); }
+  ~BPAPoolAllocator();
+
+  // Divide a region provided by the caller into blocks of (at least) blockSize bytes
+  void init(void* region, size_t size, size_t blockSize);
+
+  // Allocate room for nBlocks blocks from the heap in one piece. Returns false if that fails.
+  bool init(size_t nBlocks, size_t blockSize);
+
+  // Requests larger than blockSize() fail
+  virtual void* allocate(size_t size, size_t alignment) override;
+  virtual void deallocate(void* p, size_t size, size_t alignment) override;
+
+  size_t blockSize() const { return _blockSize; }
+  size_t blockCount() const { return _nBlocks; }
+  size_t blocksInUse() const { return _inUse; }
+  size_t highWaterMark() const { return _highWater; }   // In blocks
+  uint16_t failedAllocations() const { return _nFailed; }
+
+  BPAPoolAllocator(const BPAPoolAllocator&) = delete;
+  BPAPoolAllocator& operator=(const BPAPoolAllocator&) = delete;
+
+private:
+  struct FreeBlock { FreeBlock* next; };
+
+  uint8_t* _region = nullptr;
+  FreeBlock* _freeList = nullptr;
+  size_t _blockSize = 0;
+  size_t _nBlocks = 0;
+  size_t _inUse = 0;
+  size_t _highWater = 0;
+  uint16_t _nFailed = 0;
+  bool _ownsRegion = false;
+};
+
+#endif  // BPAAllocator_h
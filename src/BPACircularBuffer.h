@@ -19,6 +19,10 @@
 #define CIRCULAR_BUFFER_H_
 #include <stdint.h>
 #include <stddef.h>
+#include <new>
+#include <utility>
+#include "BPAAllocator.h"
+#include "BPARingSupport.h"
 
 /**
  * For the push() and unshift() functions, you may choose whether to pass-by-value, pass-by-reference,
@@ -38,26 +42,57 @@ template<typename T>
 #endif
 
 
+/**
+ * BPACircularBuffer comes in two forms:
+ * o BPACircularBuffer<T> (or BPACircularBuffer<T, 0>) has a capacity that is chosen at
+ *   runtime. Storage is either allocated on the heap or provided by the client.
+ * o BPACircularBuffer<T, N> has a compile-time capacity of N and keeps its storage inline.
+ *   Index computations are folded by the compiler, and when N is a power of two they
+ *   reduce to a mask rather than a division.
+ * Both forms offer the same push/unshift/shift/pop API.
+ *
+ * When BPACircularBuffer<T> allocates its own storage (init(maxSize)), it comes from a
+ * BPAAllocator (the heap by default) and starts out as raw memory. Elements are constructed in place as they are added and destroyed as they are
+ * removed, so T need not be default constructible and unused slots cost nothing at startup.
+ * Storage provided by the client (init(space, maxSize)) is assumed to hold constructed objects,
+ * which are assigned to as elements are added.
+ *
+ * A BPACircularBuffer<T> with no capacity (never initialized, or its allocation failed) holds
+ * nothing. Adding to it does nothing and returns `false`.
+ */
+template<typename T, size_t N = 0>
+class BPACircularBuffer;
+
 template<typename T>
-class BPACircularBuffer {
+class BPACircularBuffer<T, 0> {
 public:
 
   BPACircularBuffer() {}
 
-  BPACircularBuffer(size_t maxSize) { init(maxSize); }
+  BPACircularBuffer(size_t maxSize, BPAAllocator& allocator = BPAAllocator::heap()) {
+    init(maxSize, allocator);
+  }
 
   BPACircularBuffer(T* space, size_t maxSize) { init(space, maxSize); }
 
-  ~BPACircularBuffer() {
-    if (_manageStorage) delete[] buffer;
-  }
+  ~BPACircularBuffer() { release(); }
 
-  void init(size_t maxSize) {
-    init(new T[maxSize], maxSize, true);
+  /**
+   * Allocates storage for maxSize elements from allocator. Returns `false`, leaving the buffer
+   * with no capacity, if the allocation fails. Any storage the buffer already owned is released.
+   */
+  bool init(size_t maxSize, BPAAllocator& allocator = BPAAllocator::heap()) {
+    T* space = static_cast<T*>(allocator.allocate(maxSize * sizeof(T), alignof(T)));
+    if (space == nullptr) {
+      init(nullptr, 0, nullptr);
+      return false;
+    }
+    init(space, maxSize, &allocator);
+    return true;
   }
 
   void init(T* space, size_t maxSize) {
-    init(space, maxSize, false);
+    init(space, maxSize, nullptr);
   }
   
 
@@ -77,13 +112,14 @@ public:
 	 * Adds an element to the beginning of buffer: the operation returns `false` if the addition caused overwriting an existing element.
 	 */
 	bool unshift(choose_arg_type<T> value){
+    if (_capacity == 0) return false;
     if (head == buffer) {
-      head = buffer + capacity;
+      head = buffer + _capacity;
     }
-    *--head = value;
-    if (count == capacity) {
+    put(--head, count == _capacity, value);
+    if (count == _capacity) {
       if (tail-- == buffer) {
-        tail = buffer + capacity - 1;
+        tail = buffer + _capacity - 1;
       }
       return false;
     } else {
@@ -98,21 +134,34 @@ public:
 	 * Adds an element to the end of buffer: the operation returns `false` if the addition caused overwriting an existing element.
 	 */
 	bool push(choose_arg_type<T> value) {
-    if (++tail == buffer + capacity) {
-      tail = buffer;
-    }
-    *tail = value;
-    if (count == capacity) {
-      if (++head == buffer + capacity) {
-        head = buffer;
-      }
-      return false;
-    } else {
-      if (count++ == 0) {
-        head = tail;
-      }
-      return true;
-    }
+    if (_capacity == 0) return false;
+    bool added = advanceTail();
+    put(tail, !added, value);
+    return added;
+  }
+
+	/**
+	 * Moves an element to the end of buffer: the operation returns `false` if the addition caused overwriting an existing element.
+	 * Only offered for non-fundamental types, which are the ones that benefit from a move.
+	 */
+	template<typename U = T>
+	typename std::enable_if<!std::is_fundamental<U>::value, bool>::type push(T&& value) {
+    if (_capacity == 0) return false;
+    bool added = advanceTail();
+    put(tail, !added, std::move(value));
+    return added;
+  }
+
+	/**
+	 * Constructs an element at the end of the buffer from args: the operation returns `false` if the addition caused
+	 * overwriting an existing element. Use back() to get at the new element.
+	 */
+	template<typename... Args>
+	bool emplace(Args&&... args) {
+    if (_capacity == 0) return false;
+    bool added = advanceTail();
+    constructAt(tail, !added, std::forward<Args>(args)...);
+    return added;
   }
 
 	/**
@@ -121,8 +170,9 @@ public:
 	 */
 	T shift() {
     if (count == 0) return *head;
-    T result = *head++;
-    if (head >= buffer + capacity) {
+    T result = std::move(*head);
+    destroy(head++);
+    if (head >= buffer + _capacity) {
       head = buffer;
     }
     count--;
@@ -135,14 +185,41 @@ public:
 	 */
 	T pop() {
     if (count == 0) return *tail;
-    T result = *tail--;
+    T result = std::move(*tail);
+    destroy(tail--);
     if (tail < buffer) {
-      tail = buffer + capacity - 1;
+      tail = buffer + _capacity - 1;
     }
     count--;
     return result;
   }
 
+	/**
+	 * Removes an element from the end of the buffer and moves it into value.
+	 * Returns `false`, and leaves value unchanged, if the buffer is empty.
+	 */
+	bool popInto(T& value) {
+    if (count == 0) return false;
+    value = std::move(*tail);
+    destroy(tail);
+    if (tail == buffer) tail = buffer + _capacity;
+    --tail;
+    count--;
+    return true;
+  }
+
+	/**
+	 * Removes the element at the beginning of the buffer without copying it.
+	 * Returns `false` if the buffer is empty.
+	 */
+	bool discardFront() {
+    if (count == 0) return false;
+    destroy(head);
+    if (++head == buffer + _capacity) head = buffer;
+    count--;
+    return true;
+  }
+
 	/**
 	 * Returns the element at the beginning of the buffer.
 	 */
@@ -153,6 +230,19 @@ public:
 	 */
 	T inline last() const { return *tail; }
 
+	/**
+	 * Returns a reference to the element at the beginning of the buffer.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	const T& front() const { return *head; }
+
+	/**
+	 * Returns a reference to the element at the end of the buffer.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	const T& back() const { return *tail; }
+	T& back() { return *tail; }
+
 	/**
 	 * Array-like access to buffer.
 	 * Calling this operation using and index value greater than `size - 1` returns the tail element.
@@ -160,7 +250,7 @@ public:
 	 */
 	T operator [] (size_t index) const {
     if (index >= count) return *tail;
-    return *(buffer + ((head - buffer + index) % capacity));
+    return *(buffer + physicalIndex(index));
   }
    
 
@@ -172,9 +262,115 @@ public:
 	 */
 	const T& peekAt(size_t index) const {
     if (index >= count) return *tail;
-    return (buffer[(head - buffer + index) % capacity]);
+    return (buffer[physicalIndex(index)]);
   }
 
+  using const_iterator = bpa::RingIterator<const T>;
+
+	/**
+	 * Random access iterators over the elements, from the beginning of the buffer to the end.
+	 */
+	const_iterator begin() const { return const_iterator(buffer, _capacity, head - buffer, 0); }
+	const_iterator end() const { return const_iterator(buffer, _capacity, head - buffer, count); }
+
+	/**
+	 * Returns the elements as at most two contiguous segments. Visiting asSpans().first
+	 * and then asSpans().second yields the elements from the beginning of the buffer to the end.
+	 */
+	bpa::RingSpans<const T> asSpans() const {
+    return bpa::makeRingSpans<const T>(buffer, _capacity, head - buffer, count);
+  }
+
+	/**
+	 * Returns n elements, starting with the element at index, as at most two contiguous segments.
+	 * The range is clipped to the elements that are in the buffer.
+	 */
+	bpa::RingSpans<const T> asSpans(size_t index, size_t n) const {
+    if (index > count) index = count;
+    if (n > count - index) n = count - index;
+    return bpa::makeRingSpans<const T>(buffer, _capacity, physicalIndex(index), n);
+  }
+
+	/**
+	 * Adds the elements of items to the end of the buffer, in order. The result is the same as
+	 * calling push() for each element, but trivially copyable elements are moved with at most two
+	 * memcpy calls. Returns `false` if the addition caused overwriting existing elements.
+	 */
+	bool pushMany(bpa::span<const T> items) {
+    if (items.empty()) return true;
+    if (_capacity == 0) return false;
+    if (needsElementwiseCopy()) {
+      bool added = true;
+      for (const T& item : items) added &= push(item);
+      return added;
+    }
+    bool overwrote = (count + items.size() > _capacity);
+    if (items.size() > _capacity) items = items.last(_capacity);  // Only the newest survive
+    size_t n = items.size();
+    size_t start = physicalIndex(count);
+    bpa::copyIntoRing<T>(buffer, _capacity, start, items.data(), n);
+    size_t newCount = overwrote ? _capacity : count + n;
+    size_t last = wrapSlot(start, n - 1);
+    tail = buffer + last;
+    head = buffer + wrapSlot(last, _capacity - newCount + 1);
+    count = newCount;
+    return !overwrote;
+  }
+
+	/**
+	 * Adds the elements of items to the beginning of the buffer. They keep their relative order, so
+	 * items[0] becomes the first element. The result is the same as calling unshift() for each element
+	 * from last to first. Returns `false` if the addition caused overwriting existing elements.
+	 */
+	bool unshiftMany(bpa::span<const T> items) {
+    if (items.empty()) return true;
+    if (_capacity == 0) return false;
+    if (needsElementwiseCopy()) {
+      bool added = true;
+      for (size_t i = items.size(); i-- > 0; ) added &= unshift(items[i]);
+      return added;
+    }
+    bool overwrote = (count + items.size() > _capacity);
+    if (items.size() > _capacity) items = items.first(_capacity);
+    size_t n = items.size();
+    size_t start = wrapSlot(head - buffer, _capacity - n);
+    bpa::copyIntoRing<T>(buffer, _capacity, start, items.data(), n);
+    size_t newCount = overwrote ? _capacity : count + n;
+    head = buffer + start;
+    tail = buffer + wrapSlot(start, newCount - 1);
+    count = newCount;
+    return !overwrote;
+  }
+
+	/**
+	 * Copies up to dst.size() elements, beginning with the element at index start, into dst.
+	 * The buffer is not modified. Returns the number of elements copied.
+	 */
+	size_t copyOut(bpa::span<T> dst, size_t start = 0) const {
+    if (start >= count) return 0;
+    size_t n = count - start;
+    if (n > dst.size()) n = dst.size();
+    bpa::copyFromRing<T>(buffer, _capacity, physicalIndex(start), dst.data(), n);
+    return n;
+  }
+
+	/**
+	 * Removes up to dst.size() elements from the beginning of the buffer and copies them into dst.
+	 * Returns the number of elements removed.
+	 */
+	size_t drainInto(bpa::span<T> dst) {
+    size_t n = copyOut(dst);
+    for (size_t i = 0; i < n; i++) destroy(buffer + physicalIndex(i));
+    head = buffer + wrapSlot(head - buffer, n);
+    count -= n;
+    return n;
+  }
+
+  /**
+   * Returns the maximum capacity of the buffer.
+   */
+  size_t inline capacity() const { return _capacity; }
+
 	/**
 	 * Returns how many elements are actually stored in the buffer.
 	 */
@@ -183,7 +379,7 @@ public:
 	/**
 	 * Returns how many elements can be safely pushed into the buffer.
 	 */
-	size_t inline available() const { return capacity - count; }
+	size_t inline available() const { return _capacity - count; }
 
 	/**
 	 * Returns `true` if no elements can be removed from the buffer.
@@ -193,31 +389,100 @@ public:
 	/**
 	 * Returns `true` if no elements can be added to the buffer without overwriting existing elements.
 	 */
-	bool inline isFull() const { return count == capacity; }
+	bool inline isFull() const { return count == _capacity; }
 
 	/**
 	 * Resets the buffer to a clean status, making all buffer positions available.
 	 */
 	void inline clear() {
+    destroyAll();
     head = tail = buffer;
     count = 0;
   }
 
 
 private:
+  // Store value in slot. When we manage the storage, a slot that isn't live is raw
+  // memory, so the value is copy/move constructed there rather than assigned.
+  template<typename V>
+  void put(T* slot, bool live, V&& value) {
+    if (live || !_allocator) *slot = std::forward<V>(value);
+    else new (slot) T(std::forward<V>(value));
+  }
+
+  template<typename... Args>
+  void constructAt(T* slot, bool live, Args&&... args) {
+    if (!_allocator) { *slot = T(std::forward<Args>(args)...); return; }
+    if (live) slot->~T();
+    new (slot) T(std::forward<Args>(args)...);
+  }
+
+  void inline destroy(T* slot) {
+    if (_allocator) slot->~T();
+  }
+
+  void destroyAll() {
+    if (std::is_trivially_destructible<T>::value || !_allocator) return;
+    for (size_t i = 0; i < count; i++) buffer[physicalIndex(i)].~T();
+  }
+
+  // Bulk copies use assignment (or memcpy). That's only valid on raw slots if T is
+  // trivially copyable; otherwise the bulk operations fall back to push/unshift.
+  bool inline needsElementwiseCopy() const {
+    return _allocator && !std::is_trivially_copyable<T>::value;
+  }
 
-  void init(T* space, size_t maxSize, bool manage) {
+  // Destroy the elements and return the storage, if we own it
+  void release() {
+    if (_allocator) {
+      destroyAll();
+      _allocator->deallocate(buffer, _capacity * sizeof(T), alignof(T));
+      _allocator = nullptr;
+    }
+  }
+
+  // A non-null allocator means that we own the storage and must return it
+  void init(T* space, size_t maxSize, BPAAllocator* allocator) {
+    release();
     buffer = space;
-    capacity = maxSize;
-    _manageStorage = manage;
+    _capacity = maxSize;
+    _allocator = allocator;
     head = buffer;
     tail = buffer;
     count = 0;
   }
 
+  // Moves tail to the slot for a new last element and updates the bookkeeping.
+  // Returns `false` if that slot held the first element, which is being overwritten.
+  bool advanceTail() {
+    if (++tail == buffer + _capacity) {
+      tail = buffer;
+    }
+    if (count == _capacity) {
+      if (++head == buffer + _capacity) {
+        head = buffer;
+      }
+      return false;
+    }
+    if (count++ == 0) {
+      head = tail;
+    }
+    return true;
+  }
+
+  // Advances slot by k (<= _capacity) positions, wrapping at the end of storage.
+  // A single conditional subtraction replaces the modulo.
+  size_t inline wrapSlot(size_t slot, size_t k) const {
+    size_t i = slot + k;
+    return (i >= _capacity) ? i - _capacity : i;
+  }
+
+  // Maps a logical index to a slot in buffer
+  size_t inline physicalIndex(size_t index) const { return wrapSlot(head - buffer, index); }
+
 	T* buffer = nullptr;
-  size_t capacity = 0;
-  bool _manageStorage = false;
+  size_t _capacity = 0;
+  BPAAllocator* _allocator = nullptr;
 
 	T *head = nullptr;
 	T *tail = nullptr;
@@ -228,4 +493,305 @@ private:
 #endif
 };
 
+template<typename T, size_t N>
+class BPACircularBuffer {
+public:
+  static_assert(N > 0, "Use BPACircularBuffer<T> for a runtime capacity");
+
+  BPACircularBuffer() {}
+
+	/**
+	 * Disables copy constructor
+	 */
+	BPACircularBuffer(const BPACircularBuffer&) = delete;
+	BPACircularBuffer(BPACircularBuffer&&) = delete;
+
+	/**
+	 * Disables assignment operator
+	 */
+	BPACircularBuffer& operator=(const BPACircularBuffer&) = delete;
+	BPACircularBuffer& operator=(BPACircularBuffer&&) = delete;
+
+	/**
+	 * Adds an element to the beginning of buffer: the operation returns `false` if the addition caused overwriting an existing element.
+	 */
+	bool unshift(choose_arg_type<T> value) {
+    _head = wrap(_head + N - 1);
+    buffer[_head] = value;
+    if (count == N) return false;
+    count++;
+    return true;
+  }
+
+	/**
+	 * Adds an element to the end of buffer: the operation returns `false` if the addition caused overwriting an existing element.
+	 */
+	bool push(choose_arg_type<T> value) {
+    size_t slot;
+    bool added = advanceTail(slot);
+    buffer[slot] = value;
+    return added;
+  }
+
+	/**
+	 * Moves an element to the end of buffer: the operation returns `false` if the addition caused overwriting an existing element.
+	 * Only offered for non-fundamental types, which are the ones that benefit from a move.
+	 */
+	template<typename U = T>
+	typename std::enable_if<!std::is_fundamental<U>::value, bool>::type push(T&& value) {
+    size_t slot;
+    bool added = advanceTail(slot);
+    buffer[slot] = std::move(value);
+    return added;
+  }
+
+	/**
+	 * Constructs an element at the end of the buffer from args: the operation returns `false` if the addition caused
+	 * overwriting an existing element. Use back() to get at the new element.
+	 */
+	template<typename... Args>
+	bool emplace(Args&&... args) {
+    size_t slot;
+    bool added = advanceTail(slot);
+    buffer[slot] = T(std::forward<Args>(args)...);
+    return added;
+  }
+
+	/**
+	 * Removes an element from the beginning of the buffer.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	T shift() {
+    if (count == 0) return buffer[_head];
+    T result = std::move(buffer[_head]);
+    _head = wrap(_head + 1);
+    count--;
+    return result;
+  }
+
+	/**
+	 * Removes an element from the end of the buffer.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	T pop() {
+    if (count == 0) return buffer[tailIndex()];
+    T result = std::move(buffer[tailIndex()]);
+    count--;
+    return result;
+  }
+
+	/**
+	 * Removes an element from the end of the buffer and moves it into value.
+	 * Returns `false`, and leaves value unchanged, if the buffer is empty.
+	 */
+	bool popInto(T& value) {
+    if (count == 0) return false;
+    value = std::move(buffer[tailIndex()]);
+    count--;
+    return true;
+  }
+
+	/**
+	 * Removes the element at the beginning of the buffer without copying it.
+	 * Returns `false` if the buffer is empty.
+	 */
+	bool discardFront() {
+    if (count == 0) return false;
+    _head = wrap(_head + 1);
+    count--;
+    return true;
+  }
+
+	/**
+	 * Returns the element at the beginning of the buffer.
+	 */
+	T inline first() const { return buffer[_head]; }
+
+	/**
+	 * Returns the element at the end of the buffer.
+	 */
+	T inline last() const { return buffer[tailIndex()]; }
+
+	/**
+	 * Returns a reference to the element at the beginning of the buffer.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	const T& front() const { return buffer[_head]; }
+
+	/**
+	 * Returns a reference to the element at the end of the buffer.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	const T& back() const { return buffer[tailIndex()]; }
+	T& back() { return buffer[tailIndex()]; }
+
+	/**
+	 * Array-like access to buffer.
+	 * Calling this operation using and index value greater than `size - 1` returns the tail element.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	T operator [] (size_t index) const {
+    if (index >= count) return buffer[tailIndex()];
+    return buffer[wrap(_head + index)];
+  }
+
+	/**
+	 * Similar to operator [], but returns a const ref to the stored element rather than a copy.
+	 * Calling this operation using and index value greater than `size - 1` returns the tail element.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	const T& peekAt(size_t index) const {
+    if (index >= count) return buffer[tailIndex()];
+    return buffer[wrap(_head + index)];
+  }
+
+  using const_iterator = bpa::RingIterator<const T>;
+
+	/**
+	 * Random access iterators over the elements, from the beginning of the buffer to the end.
+	 */
+	const_iterator begin() const { return const_iterator(buffer, N, _head, 0); }
+	const_iterator end() const { return const_iterator(buffer, N, _head, count); }
+
+	/**
+	 * Returns the elements as at most two contiguous segments. Visiting asSpans().first
+	 * and then asSpans().second yields the elements from the beginning of the buffer to the end.
+	 */
+	bpa::RingSpans<const T> asSpans() const {
+    return bpa::makeRingSpans<const T>(buffer, N, _head, count);
+  }
+
+	/**
+	 * Returns n elements, starting with the element at index, as at most two contiguous segments.
+	 * The range is clipped to the elements that are in the buffer.
+	 */
+	bpa::RingSpans<const T> asSpans(size_t index, size_t n) const {
+    if (index > count) index = count;
+    if (n > count - index) n = count - index;
+    return bpa::makeRingSpans<const T>(buffer, N, wrap(_head + index), n);
+  }
+
+	/**
+	 * Adds the elements of items to the end of the buffer, in order. The result is the same as
+	 * calling push() for each element, but trivially copyable elements are moved with at most two
+	 * memcpy calls. Returns `false` if the addition caused overwriting existing elements.
+	 */
+	bool pushMany(bpa::span<const T> items) {
+    if (items.empty()) return true;
+    bool overwrote = (count + items.size() > N);
+    if (items.size() > N) items = items.last(N);  // Only the newest survive
+    size_t n = items.size();
+    size_t start = wrap(_head + count);
+    bpa::copyIntoRing<T>(buffer, N, start, items.data(), n);
+    size_t newCount = overwrote ? N : count + n;
+    _head = wrap(wrap(start + n) + N - newCount);
+    count = newCount;
+    return !overwrote;
+  }
+
+	/**
+	 * Adds the elements of items to the beginning of the buffer. They keep their relative order, so
+	 * items[0] becomes the first element. The result is the same as calling unshift() for each element
+	 * from last to first. Returns `false` if the addition caused overwriting existing elements.
+	 */
+	bool unshiftMany(bpa::span<const T> items) {
+    if (items.empty()) return true;
+    bool overwrote = (count + items.size() > N);
+    if (items.size() > N) items = items.first(N);
+    size_t n = items.size();
+    _head = wrap(_head + N - n);
+    bpa::copyIntoRing<T>(buffer, N, _head, items.data(), n);
+    count = overwrote ? N : count + n;
+    return !overwrote;
+  }
+
+	/**
+	 * Copies up to dst.size() elements, beginning with the element at index start, into dst.
+	 * The buffer is not modified. Returns the number of elements copied.
+	 */
+	size_t copyOut(bpa::span<T> dst, size_t start = 0) const {
+    if (start >= count) return 0;
+    size_t n = count - start;
+    if (n > dst.size()) n = dst.size();
+    bpa::copyFromRing<T>(buffer, N, wrap(_head + start), dst.data(), n);
+    return n;
+  }
+
+	/**
+	 * Removes up to dst.size() elements from the beginning of the buffer and copies them into dst.
+	 * Returns the number of elements removed.
+	 */
+	size_t drainInto(bpa::span<T> dst) {
+    size_t n = copyOut(dst);
+    _head = wrap(_head + n);
+    count -= n;
+    return n;
+  }
+
+  /**
+   * Returns the maximum capacity of the buffer.
+   */
+  static constexpr size_t capacity() { return N; }
+
+	/**
+	 * Returns how many elements are actually stored in the buffer.
+	 */
+	size_t inline size() const { return count; }
+
+	/**
+	 * Returns how many elements can be safely pushed into the buffer.
+	 */
+	size_t inline available() const { return N - count; }
+
+	/**
+	 * Returns `true` if no elements can be removed from the buffer.
+	 */
+	bool inline isEmpty() const { return count == 0; }
+
+	/**
+	 * Returns `true` if no elements can be added to the buffer without overwriting existing elements.
+	 */
+	bool inline isFull() const { return count == N; }
+
+	/**
+	 * Resets the buffer to a clean status, making all buffer positions available.
+	 */
+	void inline clear() {
+    _head = 0;
+    count = 0;
+  }
+
+
+private:
+  static constexpr bool IsPowerOfTwo = (N & (N - 1)) == 0;
+
+  // Callers never pass a value >= 2N, so when N isn't a power of two a compare
+  // and subtract is enough.
+  static constexpr size_t wrap(size_t i) {
+    return IsPowerOfTwo ? (i & (N - 1)) : ((i >= N) ? i - N : i);
+  }
+
+  size_t inline tailIndex() const { return wrap(_head + (count ? count : N) - 1); }
+
+  // Finds the slot for a new last element and updates the bookkeeping. Returns
+  // `false` if that slot held the first element, which is being overwritten.
+  bool advanceTail(size_t& slot) {
+    slot = wrap(_head + count);
+    if (count == N) {
+      _head = wrap(_head + 1);
+      return false;
+    }
+    count++;
+    return true;
+  }
+
+	T buffer[N];
+  size_t _head = 0;
+#ifndef CIRCULAR_BUFFER_INT_SAFE
+	size_t count = 0;
+#else
+	volatile size_t count = 0;
+#endif
+};
+
 #endif
@@ -2,7 +2,7 @@
  * BPAFixedSizeBuffer
  *    A simple fixed size array that can be manipulated with push/pop and shift/unshift.
  *    It keeps a count of the current number of elements and the _capacity. Storage may be
- *    allocated on the heap, or provided by the client.
+ *    allocated from a BPAAllocator (the heap by default), or provided by the client.
  *
  */
 
@@ -11,6 +11,10 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <new>
+#include <utility>
+#include "BPAAllocator.h"
+#include "BPARingSupport.h"
 
 /**
  * For the push() and unshift() functions, you may choose whether to pass-by-value, pass-by-reference,
@@ -36,7 +40,9 @@ public:
 
   BPAFixedSizeBuffer() = default;	// Can't use until init() is called!
 
-  BPAFixedSizeBuffer(size_t maxSize) { init(maxSize); }
+  BPAFixedSizeBuffer(size_t maxSize, BPAAllocator& allocator = BPAAllocator::heap()) {
+    init(maxSize, allocator);
+  }
 
   BPAFixedSizeBuffer(T* space, size_t maxSize, bool initialized = false) {
   	init(space, maxSize);
@@ -48,16 +54,25 @@ public:
   	}
   }
 
-  ~BPAFixedSizeBuffer() {
-    if (_manageStorage) delete[] buffer;
-  }
+  ~BPAFixedSizeBuffer() { release(); }
 
-  void init(size_t maxSize) {
-    init(new T[maxSize], maxSize, true);
+  /**
+   * Allocates storage for maxSize elements from allocator. Returns `false`, leaving the buffer
+   * with no capacity, if the allocation fails. Any storage the buffer already owned is released.
+   */
+  bool init(size_t maxSize, BPAAllocator& allocator = BPAAllocator::heap()) {
+    T* space = static_cast<T*>(allocator.allocate(maxSize * sizeof(T), alignof(T)));
+    if (space == nullptr) {
+      init(nullptr, 0, nullptr);
+      return false;
+    }
+    for (size_t i = 0; i < maxSize; i++) new (space + i) T();
+    init(space, maxSize, &allocator);
+    return true;
   }
 
   void init(T* space, size_t maxSize) {
-    init(space, maxSize, false);
+    init(space, maxSize, nullptr);
   }
   
 
@@ -89,13 +104,30 @@ public:
 	 * Adds an element to the end of buffer if there is space
 	 */
 	bool push(choose_arg_type<T> value) {
-		if (count == _capacity) return false;
-
-    if (++tail == buffer + _capacity) { tail = buffer; }
+		if (!advanceTail()) return false;
     *tail = value;
+    return true;
+  }
 
-    if (isEmpty()) { head = tail; }
-    count++;
+	/**
+	 * Moves an element to the end of buffer if there is space.
+	 * Only offered for non-fundamental types, which are the ones that benefit from a move.
+	 */
+	template<typename U = T>
+	typename std::enable_if<!std::is_fundamental<U>::value, bool>::type push(T&& value) {
+		if (!advanceTail()) return false;
+    *tail = std::move(value);
+    return true;
+  }
+
+	/**
+	 * Constructs an element at the end of the buffer from args if there is space.
+	 * Use back() to get at the new element.
+	 */
+	template<typename... Args>
+	bool emplace(Args&&... args) {
+		if (!advanceTail()) return false;
+    *tail = T(std::forward<Args>(args)...);
     return true;
   }
 
@@ -105,7 +137,7 @@ public:
 	 */
 	T shift() {
     if (count == 0) return *head;
-    T result = *head++;
+    T result = std::move(*head++);
     if (head >= buffer + _capacity) { head = buffer; }
     count--;
     return result;
@@ -117,12 +149,36 @@ public:
 	 */
 	T pop() {
     if (count == 0) return *tail;
-    T result = *tail--;
+    T result = std::move(*tail--);
     if (tail < buffer) { tail = buffer + _capacity - 1; }
     count--;
     return result;
   }
 
+	/**
+	 * Removes an element from the end of the buffer and moves it into value.
+	 * Returns `false`, and leaves value unchanged, if the buffer is empty.
+	 */
+	bool popInto(T& value) {
+    if (count == 0) return false;
+    value = std::move(*tail);
+    if (tail == buffer) { tail = buffer + _capacity; }
+    --tail;
+    count--;
+    return true;
+  }
+
+	/**
+	 * Removes the element at the beginning of the buffer without copying it.
+	 * Returns `false` if the buffer is empty.
+	 */
+	bool discardFront() {
+    if (count == 0) return false;
+    if (++head == buffer + _capacity) { head = buffer; }
+    count--;
+    return true;
+  }
+
 	/**
 	 * Returns the element at the beginning of the buffer.
 	 */
@@ -133,6 +189,19 @@ public:
 	 */
 	T inline last() const { return *tail; }
 
+	/**
+	 * Returns a reference to the element at the beginning of the buffer.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	const T& front() const { return *head; }
+
+	/**
+	 * Returns a reference to the element at the end of the buffer.
+	 * *WARNING* Calling this operation on an empty buffer has an unpredictable behaviour.
+	 */
+	const T& back() const { return *tail; }
+	T& back() { return *tail; }
+
 	/**
 	 * Array-like access to buffer.
 	 * Calling this operation using and index value greater than `size - 1` returns the tail element.
@@ -140,7 +209,7 @@ public:
 	 */
 	T operator [] (size_t index) const {
     if (index >= count) return *tail;
-    return *(buffer + ((head - buffer + index) % _capacity));
+    return *(buffer + physicalIndex(index));
   }
    
 
@@ -152,7 +221,89 @@ public:
 	 */
 	const T& peekAt(size_t index) const {
     if (index >= count) return *tail;
-    return (buffer[(head - buffer + index) % _capacity]);
+    return (buffer[physicalIndex(index)]);
+  }
+
+  using const_iterator = bpa::RingIterator<const T>;
+
+	/**
+	 * Random access iterators over the elements, from the beginning of the buffer to the end.
+	 */
+	const_iterator begin() const { return const_iterator(buffer, _capacity, head - buffer, 0); }
+	const_iterator end() const { return const_iterator(buffer, _capacity, head - buffer, count); }
+
+	/**
+	 * Returns the elements as at most two contiguous segments. Visiting asSpans().first
+	 * and then asSpans().second yields the elements from the beginning of the buffer to the end.
+	 */
+	bpa::RingSpans<const T> asSpans() const {
+    return bpa::makeRingSpans<const T>(buffer, _capacity, head - buffer, count);
+  }
+
+	/**
+	 * Returns n elements, starting with the element at index, as at most two contiguous segments.
+	 * The range is clipped to the elements that are in the buffer.
+	 */
+	bpa::RingSpans<const T> asSpans(size_t index, size_t n) const {
+    if (index > count) index = count;
+    if (n > count - index) n = count - index;
+    return bpa::makeRingSpans<const T>(buffer, _capacity, physicalIndex(index), n);
+  }
+
+	/**
+	 * Adds as many elements of items as will fit to the end of the buffer, in order. Trivially
+	 * copyable elements are moved with at most two memcpy calls. Returns the number of elements added.
+	 */
+	size_t pushMany(bpa::span<const T> items) {
+    if (items.size() > _capacity - count) items = items.first(_capacity - count);
+    size_t n = items.size();
+    if (n == 0) return 0;
+    size_t start = physicalIndex(count);
+    bpa::copyIntoRing<T>(buffer, _capacity, start, items.data(), n);
+    head = buffer + wrapSlot(start, _capacity - count);
+    tail = buffer + wrapSlot(start, n - 1);
+    count += n;
+    return n;
+  }
+
+	/**
+	 * Adds elements of items to the beginning of the buffer, keeping their relative order. If there
+	 * isn't room for all of them, the ones at the end of items (those that would be adjacent to the
+	 * current first element) are added. Returns the number of elements added.
+	 */
+	size_t unshiftMany(bpa::span<const T> items) {
+    if (items.size() > _capacity - count) items = items.last(_capacity - count);
+    size_t n = items.size();
+    if (n == 0) return 0;
+    size_t start = wrapSlot(head - buffer, _capacity - n);
+    bpa::copyIntoRing<T>(buffer, _capacity, start, items.data(), n);
+    head = buffer + start;
+    tail = buffer + wrapSlot(start, count + n - 1);
+    count += n;
+    return n;
+  }
+
+	/**
+	 * Copies up to dst.size() elements, beginning with the element at index start, into dst.
+	 * The buffer is not modified. Returns the number of elements copied.
+	 */
+	size_t copyOut(bpa::span<T> dst, size_t start = 0) const {
+    if (start >= count) return 0;
+    size_t n = count - start;
+    if (n > dst.size()) n = dst.size();
+    bpa::copyFromRing<T>(buffer, _capacity, physicalIndex(start), dst.data(), n);
+    return n;
+  }
+
+	/**
+	 * Removes up to dst.size() elements from the beginning of the buffer and copies them into dst.
+	 * Returns the number of elements removed.
+	 */
+	size_t drainInto(bpa::span<T> dst) {
+    size_t n = copyOut(dst);
+    head = buffer + wrapSlot(head - buffer, n);
+    count -= n;
+    return n;
   }
 
   /**
@@ -191,18 +342,49 @@ public:
 
 private:
 
-  void init(T* space, size_t maxSize, bool manage) {
+  // Destroy the elements and return the storage, if we own it
+  void release() {
+    if (_allocator) {
+      for (size_t i = 0; i < _capacity; i++) buffer[i].~T();
+      _allocator->deallocate(buffer, _capacity * sizeof(T), alignof(T));
+      _allocator = nullptr;
+    }
+  }
+
+  // A non-null allocator means that we own the storage and must return it
+  void init(T* space, size_t maxSize, BPAAllocator* allocator) {
+    release();
     buffer = space;
     _capacity = maxSize;
-    _manageStorage = manage;
+    _allocator = allocator;
     head = buffer;
     tail = buffer;
     count = 0;
   }
 
+  // Moves tail to the slot for a new last element and updates the bookkeeping.
+  // Returns `false`, and changes nothing, if the buffer is full.
+  bool advanceTail() {
+		if (count == _capacity) return false;
+    if (++tail == buffer + _capacity) { tail = buffer; }
+    if (isEmpty()) { head = tail; }
+    count++;
+    return true;
+  }
+
+  // Advances slot by k (<= _capacity) positions, wrapping at the end of storage.
+  // A single conditional subtraction replaces the modulo.
+  size_t inline wrapSlot(size_t slot, size_t k) const {
+    size_t i = slot + k;
+    return (i >= _capacity) ? i - _capacity : i;
+  }
+
+  // Maps a logical index to a slot in buffer
+  size_t inline physicalIndex(size_t index) const { return wrapSlot(head - buffer, index); }
+
 	T* buffer = nullptr;
   size_t _capacity = 0;
-  bool _manageStorage = false;
+  BPAAllocator* _allocator = nullptr;
 
 	T *head = nullptr;
 	T *tail = nullptr;
@@ -0,0 +1,157 @@
+/*
+ * BPAMPMCBuffer
+ *    A bounded, lock-free queue that any number of producers and consumers may
+ *    use concurrently. It is intended for cases like several FreeRTOS tasks on
+ *    an ESP32 feeding readings to the loop() that pushes them into a HistoryBuffer.
+ *    Storage is always provided by the client; the queue never allocates.
+ *
+ * NOTES:
+ * o Each slot carries a sequence number that tells producers and consumers whether
+ *   the slot is free or filled for their lap around the ring. A producer claims a
+ *   position with a single compare-and-swap and then works on its own slot, so
+ *   producers never wait on a lock or on each other's copies.
+ * o Like BPAFixedSizeBuffer, the queue never overwrites: tryPush() fails when the
+ *   queue is full and tryPop() fails when it is empty.
+ * o The number of usable slots is the largest power of two that is <= the number
+ *   of slots provided. That keeps slot selection to a mask.
+ * o A producer that is preempted between claiming a slot and filling it holds up
+ *   consumers (but not other producers) until it resumes.
+ *
+ * Usage:
+ *   BPAMPMCBuffer<Reading>::Slot slots[32];
+ *   BPAMPMCBuffer<Reading> readingQueue(slots, 32);
+ *
+ */
+
+#ifndef BPAMPMCBuffer_h
+#define BPAMPMCBuffer_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "BPASPSCBuffer.h"    // For BPA_CACHE_LINE_SIZE
+
+template<typename T>
+class BPAMPMCBuffer {
+public:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  BPAMPMCBuffer() = default;  // Can't use until init() is called!
+
+  BPAMPMCBuffer(Slot* space, size_t nSlots) { init(space, nSlots); }
+
+  void init(Slot* space, size_t nSlots) {
+    size_t usable = 1;
+    while (usable * 2 <= nSlots) usable *= 2;
+    if (nSlots == 0) usable = 0;
+
+    _slots = space;
+    _capacity = usable;
+    _mask = usable - 1;
+    for (size_t i = 0; i < usable; i++) {
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _enqueuePos.store(0, std::memory_order_relaxed);
+    _dequeuePos.store(0, std::memory_order_release);
+  }
+
+	/**
+	 * Disables copy constructor
+	 */
+	BPAMPMCBuffer(const BPAMPMCBuffer&) = delete;
+	BPAMPMCBuffer(BPAMPMCBuffer&&) = delete;
+
+	/**
+	 * Disables assignment operator
+	 */
+	BPAMPMCBuffer& operator=(const BPAMPMCBuffer&) = delete;
+	BPAMPMCBuffer& operator=(BPAMPMCBuffer&&) = delete;
+
+	/**
+	 * Adds an element to the end of the queue. Returns `false`, and leaves the queue
+	 * unchanged, if the queue is full.
+	 */
+	bool tryPush(const T& value) {
+    if (_capacity == 0) return false;
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = _slots[pos & _mask];
+      size_t seq = slot.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        // The slot is free for this lap. Try to claim it; on failure pos is reloaded.
+        if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          slot.value = value;
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;   // The slot still holds an element from the previous lap: full
+      } else {
+        pos = _enqueuePos.load(std::memory_order_relaxed);  // Another producer got here first
+      }
+    }
+  }
+
+	/**
+	 * Removes the element at the beginning of the queue and copies it into value.
+	 * Returns `false`, and leaves value unchanged, if the queue is empty.
+	 */
+	bool tryPop(T& value) {
+    if (_capacity == 0) return false;
+    size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = _slots[pos & _mask];
+      size_t seq = slot.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          value = slot.value;
+          // Mark the slot free for the producers' next lap
+          slot.sequence.store(pos + _capacity, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;   // Nothing has been published in this slot yet: empty
+      } else {
+        pos = _dequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Returns the number of usable slots.
+   */
+  size_t inline capacity() const { return _capacity; }
+
+	/**
+	 * Returns approximately how many elements are in the queue. Concurrent pushes
+	 * and pops can make the answer stale by the time it is used.
+	 */
+	size_t size() const {
+    size_t tail = _enqueuePos.load(std::memory_order_acquire);
+    size_t head = _dequeuePos.load(std::memory_order_acquire);
+    size_t n = tail - head;
+    return (n > _capacity) ? 0 : n;   // A pop completed between the two loads
+  }
+
+	/**
+	 * Returns `true` if the queue appeared to be empty at the moment of the call.
+	 */
+	bool inline isEmpty() const { return size() == 0; }
+
+
+private:
+  // Set by init(), read-only afterwards
+  Slot* _slots = nullptr;
+  size_t _capacity = 0;
+  size_t _mask = 0;
+
+  alignas(BPA_CACHE_LINE_SIZE) std::atomic<size_t> _enqueuePos{0};
+  alignas(BPA_CACHE_LINE_SIZE) std::atomic<size_t> _dequeuePos{0};
+};
+
+#endif	// BPAMPMCBuffer_h
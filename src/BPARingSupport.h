@@ -0,0 +1,144 @@
+/*
+ * BPARingSupport
+ *    Types shared by the ring style buffers (BPACircularBuffer and BPAFixedSizeBuffer)
+ *    that let clients walk the live contents without going through peekAt().
+ *
+ * NOTES:
+ * o RingIterator is a random access iterator over the logical contents of a ring.
+ *   Advancing it never divides; wrapping is a single compare and subtract.
+ * o RingSpans describes the live contents as (at most) two contiguous segments.
+ *   Bulk consumers can run a plain loop (or memcpy) over each segment in turn.
+ * o copyIntoRing / copyFromRing move a run of elements into or out of a ring.
+ *   Trivially copyable elements are moved with at most two memcpy calls.
+ *
+ */
+
+#ifndef BPARingSupport_h
+#define BPARingSupport_h
+
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <type_traits>
+#include "bpa_span.h"
+
+namespace bpa {
+
+  template<typename T>
+  struct RingSpans {
+    span<T> first;   // From the oldest element up to the end of storage (or the newest element)
+    span<T> second;  // The wrapped portion, starting at the beginning of storage. May be empty.
+
+    size_t size() const { return first.size() + second.size(); }
+    bool empty() const { return first.empty(); }
+  };
+
+  template<typename T>
+  class RingIterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename std::remove_const<T>::type;
+    using difference_type = ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    RingIterator() = default;
+
+    // base: the start of the ring's storage, capacity: the number of slots,
+    // start: the slot holding logical element 0, index: the logical position
+    RingIterator(T* base, size_t capacity, size_t start, size_t index)
+      : _base(base), _capacity(capacity), _start(start), _index(index) { }
+
+    reference operator*() const { return _base[slot()]; }
+    pointer operator->() const { return &_base[slot()]; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    RingIterator& operator++() { ++_index; return *this; }
+    RingIterator operator++(int) { RingIterator r = *this; ++_index; return r; }
+    RingIterator& operator--() { --_index; return *this; }
+    RingIterator operator--(int) { RingIterator r = *this; --_index; return r; }
+
+    RingIterator& operator+=(difference_type n) { _index += n; return *this; }
+    RingIterator& operator-=(difference_type n) { _index -= n; return *this; }
+    RingIterator operator+(difference_type n) const { RingIterator r = *this; return r += n; }
+    RingIterator operator-(difference_type n) const { RingIterator r = *this; return r -= n; }
+    friend RingIterator operator+(difference_type n, const RingIterator& it) { return it + n; }
+
+    difference_type operator-(const RingIterator& other) const {
+      return static_cast<difference_type>(_index) - static_cast<difference_type>(other._index);
+    }
+
+    bool operator==(const RingIterator& other) const { return _index == other._index; }
+    bool operator!=(const RingIterator& other) const { return _index != other._index; }
+    bool operator<(const RingIterator& other) const { return _index < other._index; }
+    bool operator>(const RingIterator& other) const { return _index > other._index; }
+    bool operator<=(const RingIterator& other) const { return _index <= other._index; }
+    bool operator>=(const RingIterator& other) const { return _index >= other._index; }
+
+    // The logical position of this iterator within the ring
+    size_t index() const { return _index; }
+
+  private:
+    size_t slot() const {
+      size_t i = _start + _index;
+      return (i >= _capacity) ? i - _capacity : i;
+    }
+
+    T* _base = nullptr;
+    size_t _capacity = 0;
+    size_t _start = 0;
+    size_t _index = 0;
+  };
+
+  // Describe count live elements that begin at slot start of a ring with the
+  // given storage and capacity as at most two contiguous segments.
+  template<typename T>
+  RingSpans<T> makeRingSpans(T* base, size_t capacity, size_t start, size_t count) {
+    size_t firstLen = capacity - start;
+    if (firstLen > count) firstLen = count;
+    RingSpans<T> spans;
+    spans.first = span<T>(base + start, firstLen);
+    spans.second = span<T>(base, count - firstLen);
+    return spans;
+  }
+
+  namespace internal {
+    template<typename T>
+    void copyElements(T* dst, const T* src, size_t n, std::true_type /* trivially copyable */) {
+      if (n) memcpy(dst, src, n * sizeof(T));
+    }
+
+    template<typename T>
+    void copyElements(T* dst, const T* src, size_t n, std::false_type /* trivially copyable */) {
+      for (size_t i = 0; i < n; i++) dst[i] = src[i];
+    }
+
+    template<typename T>
+    void copyElements(T* dst, const T* src, size_t n) {
+      copyElements(dst, src, n, std::integral_constant<bool, std::is_trivially_copyable<T>::value>());
+    }
+  };
+
+  // Copy n (<= capacity) elements from src into the ring's storage beginning at slot start,
+  // wrapping around to the beginning of storage as needed
+  template<typename T>
+  void copyIntoRing(T* base, size_t capacity, size_t start, const T* src, size_t n) {
+    size_t firstLen = capacity - start;
+    if (firstLen > n) firstLen = n;
+    internal::copyElements(base + start, src, firstLen);
+    internal::copyElements(base, src + firstLen, n - firstLen);
+  }
+
+  // Copy n (<= capacity) elements out of the ring's storage beginning at slot start,
+  // wrapping around to the beginning of storage as needed
+  template<typename T>
+  void copyFromRing(const T* base, size_t capacity, size_t start, T* dst, size_t n) {
+    size_t firstLen = capacity - start;
+    if (firstLen > n) firstLen = n;
+    internal::copyElements(dst, base + start, firstLen);
+    internal::copyElements(dst + firstLen, base, n - firstLen);
+  }
+
+};
+
+#endif  // BPARingSupport_h
@@ -0,0 +1,159 @@
+/*
+ * BPASPSCBuffer
+ *    A bounded, lock-free queue for exactly one producer and exactly one consumer.
+ *    The producer may be an ISR or another task/core, and the consumer is typically
+ *    loop(). Storage may be allocated on the heap, or provided by the client.
+ *
+ * NOTES:
+ * o Unlike BPACircularBuffer, the buffer never overwrites: tryPush() fails when the
+ *   buffer is full and tryPop() fails when it is empty.
+ * o Only the producer may call tryPush() and only the consumer may call tryPop().
+ *   size(), isEmpty() and isFull() may be called from either side, but the answer
+ *   may be stale by the time it is used.
+ * o The head (owned by the consumer) and the tail (owned by the producer) live on
+ *   separate cache lines. Each side also keeps a private copy of the other side's
+ *   index so that it only touches the shared line when the buffer looks empty/full.
+ * o Indices run from 0 to 2 * capacity - 1 so that every slot is usable and a full
+ *   buffer can be told apart from an empty one without a separate counter.
+ *
+ */
+
+#ifndef BPASPSCBuffer_h
+#define BPASPSCBuffer_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#ifndef BPA_CACHE_LINE_SIZE
+  #if defined(ESP8266)
+    #define BPA_CACHE_LINE_SIZE 4     // Single core without a data cache: don't pad
+  #elif defined(ESP32)
+    #define BPA_CACHE_LINE_SIZE 32
+  #else
+    #define BPA_CACHE_LINE_SIZE 64
+  #endif
+#endif
+
+template<typename T>
+class BPASPSCBuffer {
+public:
+
+  BPASPSCBuffer() = default;  // Can't use until init() is called!
+
+  BPASPSCBuffer(size_t maxSize) { init(maxSize); }
+
+  BPASPSCBuffer(T* space, size_t maxSize) { init(space, maxSize); }
+
+  ~BPASPSCBuffer() {
+    if (_manageStorage) delete[] _buffer;
+  }
+
+  void init(size_t maxSize) {
+    init(new T[maxSize], maxSize, true);
+  }
+
+  void init(T* space, size_t maxSize) {
+    init(space, maxSize, false);
+  }
+
+	/**
+	 * Disables copy constructor
+	 */
+	BPASPSCBuffer(const BPASPSCBuffer&) = delete;
+	BPASPSCBuffer(BPASPSCBuffer&&) = delete;
+
+	/**
+	 * Disables assignment operator
+	 */
+	BPASPSCBuffer& operator=(const BPASPSCBuffer&) = delete;
+	BPASPSCBuffer& operator=(BPASPSCBuffer&&) = delete;
+
+	/**
+	 * Producer only: adds an element to the end of the buffer. Returns `false`, and leaves
+	 * the buffer unchanged, if the buffer is full.
+	 */
+	bool tryPush(const T& value) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (distance(_cachedHead, tail) == _capacity) {
+      _cachedHead = _head.load(std::memory_order_acquire);
+      if (distance(_cachedHead, tail) == _capacity) return false;
+    }
+    _buffer[slot(tail)] = value;
+    _tail.store(advance(tail), std::memory_order_release);
+    return true;
+  }
+
+	/**
+	 * Consumer only: removes the element at the beginning of the buffer and copies it into
+	 * value. Returns `false`, and leaves value unchanged, if the buffer is empty.
+	 */
+	bool tryPop(T& value) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _cachedTail) {
+      _cachedTail = _tail.load(std::memory_order_acquire);
+      if (head == _cachedTail) return false;
+    }
+    value = _buffer[slot(head)];
+    _head.store(advance(head), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Returns the maximum capacity of the buffer.
+   */
+  size_t inline capacity() const { return _capacity; }
+
+	/**
+	 * Returns how many elements are stored in the buffer at the moment of the call.
+	 */
+	size_t size() const {
+    size_t head = _head.load(std::memory_order_acquire);
+    return distance(head, _tail.load(std::memory_order_acquire));
+  }
+
+	/**
+	 * Returns `true` if there was nothing to pop at the moment of the call.
+	 */
+	bool inline isEmpty() const { return size() == 0; }
+
+	/**
+	 * Returns `true` if there was no room to push at the moment of the call.
+	 */
+	bool inline isFull() const { return size() == _capacity; }
+
+
+private:
+
+  void init(T* space, size_t maxSize, bool manage) {
+    _buffer = space;
+    _capacity = maxSize;
+    _indexLimit = 2 * maxSize;
+    _manageStorage = manage;
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+    _cachedHead = _cachedTail = 0;
+  }
+
+  size_t inline slot(size_t index) const { return (index >= _capacity) ? index - _capacity : index; }
+  size_t inline advance(size_t index) const { return (index + 1 == _indexLimit) ? 0 : index + 1; }
+  size_t inline distance(size_t head, size_t tail) const {
+    return (tail >= head) ? tail - head : tail + _indexLimit - head;
+  }
+
+  // Set by init(), read-only afterwards
+  T* _buffer = nullptr;
+  size_t _capacity = 0;
+  size_t _indexLimit = 0;
+  bool _manageStorage = false;
+
+  // Written by the consumer
+  alignas(BPA_CACHE_LINE_SIZE) std::atomic<size_t> _head{0};
+  size_t _cachedTail = 0;
+
+  // Written by the producer
+  alignas(BPA_CACHE_LINE_SIZE) std::atomic<size_t> _tail{0};
+  size_t _cachedHead = 0;
+};
+
+#endif	// BPASPSCBuffer_h
@@ -0,0 +1,105 @@
+/*
+ * BPASeqLock
+ *    A sequence lock: writers bump a counter before and after changing some
+ *    data, and readers copy the data without locking and then check that the
+ *    counter didn't move. It is what ConcurrentHistoryBuffer is built on, and
+ *    it works with any ring buffer that provides size(), capacity(), and
+ *    asSpans(index, n).
+ *
+ * NOTES:
+ * o The counter is odd while a write is in progress. Several writers may share
+ *   a lock; they take turns. A writer never waits for a reader.
+ * o A reader that finds a writer in its way backs off and retries. After
+ *   BPA_SEQLOCK_MAX_RETRIES failed attempts it gives up and reports that it
+ *   copied nothing, so a reader can't spin forever.
+ * o Backing off: on the ESP32 the first few retries just yield(), which only
+ *   lets tasks of the same or higher priority run. Later ones use vTaskDelay(1)
+ *   so that a lower priority writer on the same core gets to finish. Even so,
+ *   readers should not run at a higher priority than the writer if they can
+ *   avoid it, since each back off costs them a tick.
+ * o Never read or write from an ISR. An ISR can't wait for the task it
+ *   interrupted.
+ * o Builds without ARDUINO (e.g. host tests) back off with std::this_thread::yield().
+ *
+ */
+
+#ifndef BPASeqLock_h
+#define BPASeqLock_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#if defined(ARDUINO)
+  #include <Arduino.h>
+#else
+  #include <thread>
+#endif
+
+#ifndef BPA_SEQLOCK_MAX_RETRIES
+  #define BPA_SEQLOCK_MAX_RETRIES 100
+#endif
+
+class BPASeqLock {
+public:
+  // Wait for any other writer, then mark a write as in progress
+  void beginWrite() {
+    uint32_t s = _sequence.load(std::memory_order_relaxed);
+    for (uint32_t attempt = 0; ; attempt++) {
+      if (!(s & 1) && _sequence.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) break;
+      if (s & 1) { backOff(attempt); s = _sequence.load(std::memory_order_relaxed); }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void endWrite() {
+    _sequence.fetch_add(1, std::memory_order_release);
+  }
+
+  // Changes each time a writer finishes
+  uint32_t sequence() const { return _sequence.load(std::memory_order_acquire); }
+
+  // Copy up to n items of buffer, starting with the one at index (or the
+  // newest n if newest is true), into dest. Returns the number copied, which
+  // is 0 if the buffer is empty or no consistent copy could be made.
+  template<typename Buffer, typename ItemType>
+  size_t snapshot(const Buffer& buffer, size_t index, size_t n, ItemType* dest, bool newest) const {
+    // A racing writer can make asSpans() skip its clipping, so never ask for
+    // more than the storage holds
+    n = std::min(n, buffer.capacity());
+    for (uint32_t attempt = 0; attempt < BPA_SEQLOCK_MAX_RETRIES; backOff(attempt++)) {
+      uint32_t before = _sequence.load(std::memory_order_acquire);
+      if (before & 1) continue;
+
+      size_t count = buffer.size();
+      size_t start = newest ? ((count > n) ? count - n : 0) : index;
+      auto spans = buffer.asSpans(start, n);
+      size_t copied = 0;
+      for (const ItemType& item : spans.first) dest[copied++] = item;
+      for (const ItemType& item : spans.second) dest[copied++] = item;
+
+      // Any change at all since before means the copy may be torn
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (_sequence.load(std::memory_order_relaxed) == before) return copied;
+    }
+    return 0;
+  }
+
+  static void backOff(uint32_t attempt) {
+#if defined(ESP32)
+    if (attempt < 8) yield();
+    else vTaskDelay(1);
+#elif defined(ARDUINO)
+    (void)attempt;
+    yield();
+#else
+    (void)attempt;
+    std::this_thread::yield();
+#endif
+  }
+
+private:
+  std::atomic<uint32_t> _sequence{0};
+};
+
+#endif  // BPASeqLock_h
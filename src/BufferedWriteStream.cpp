@@ -0,0 +1,61 @@
+/*
+ * BufferedWriteStream.cpp
+ *
+ */
+
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <string.h>
+//                                  Third Party Libraries
+//                                  Personal Libraries
+//                                  App Libraries and Includes
+#include "BufferedWriteStream.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+size_t BufferedWriteStream::write(uint8_t c) {
+  if (_used == _bufferSize) {
+    flushBuffer();
+    if (_bufferSize == 0) return _target.write(c);
+  }
+  _buffer[_used++] = c;
+  return 1;
+}
+
+size_t BufferedWriteStream::write(const uint8_t* data, size_t size) {
+  // Large writes go straight through rather than being copied piecemeal
+  if (size >= _bufferSize) {
+    flushBuffer();
+    size_t written = _target.write(data, size);
+    if (written != size) setWriteError();
+    return written;
+  }
+
+  size_t room = _bufferSize - _used;
+  if (size > room) {
+    memcpy(_buffer + _used, data, room);
+    _used = _bufferSize;
+    flushBuffer();
+    data += room;
+    size -= room;
+    memcpy(_buffer, data, size);
+    _used = size;
+    return room + size;
+  }
+
+  memcpy(_buffer + _used, data, size);
+  _used += size;
+  return size;
+}
+
+void BufferedWriteStream::flush() {
+  flushBuffer();
+  _target.flush();
+}
+
+void BufferedWriteStream::flushBuffer() {
+  if (_used == 0) return;
+  if (_target.write(_buffer, _used) != _used) setWriteError();
+  _used = 0;
+}
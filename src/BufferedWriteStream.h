@@ -0,0 +1,81 @@
+/*
+ * BufferedWriteStream
+ *     Collects output in a buffer and passes it along to another Stream in
+ *     chunks. Putting one in front of a file turns many tiny writes into a
+ *     few large ones, which matters a great deal for SPIFFS and LittleFS.
+ *
+ * NOTES:
+ * o The buffer is written to the target when it fills, when flush() is
+ *   called, and when the BufferedWriteStream is destroyed.
+ * o The buffer is provided by the caller, or is part of the object when
+ *   using StaticBufferedWriteStream. Nothing is allocated on the heap.
+ * o This is a write-only Stream. The read functions behave as though
+ *   there is never anything to read.
+ * o If the target accepts fewer bytes than it was given, the write error
+ *   is set (see Print::getWriteError()) and the unwritten data is dropped.
+ *
+ * Usage:
+ *   File file = ESP_FS::open(path, "w");
+ *   StaticBufferedWriteStream<> out(file);
+ *   history.store(out);
+ *   out.flush();
+ *
+ */
+
+#ifndef BufferedWriteStream_h
+#define BufferedWriteStream_h
+
+#include <Arduino.h>
+
+#ifndef BPA_STORE_BUFFER_SIZE
+  #define BPA_STORE_BUFFER_SIZE 256
+#endif
+
+class BufferedWriteStream : public Stream {
+public:
+  BufferedWriteStream(Stream& target, uint8_t* buffer, size_t bufferSize) :
+      _target(target), _buffer(buffer), _bufferSize(bufferSize) { }
+
+  ~BufferedWriteStream() { flushBuffer(); }
+
+	/**
+	 * Disables copy constructor and assignment operator
+	 */
+  BufferedWriteStream(const BufferedWriteStream&) = delete;
+  BufferedWriteStream& operator=(const BufferedWriteStream&) = delete;
+
+  // ----- Print
+  virtual size_t write(uint8_t c) override;
+  virtual size_t write(const uint8_t* data, size_t size) override;
+
+  // Write any buffered data to the target and then flush the target
+  virtual void flush() override;
+
+  // ----- Stream
+  virtual int available() override { return 0; }
+  virtual int read() override { return -1; }
+  virtual int peek() override { return -1; }
+
+  // The number of bytes waiting in the buffer
+  size_t pending() const { return _used; }
+
+private:
+  Stream& _target;
+  uint8_t* _buffer;
+  size_t _bufferSize;
+  size_t _used = 0;
+
+  void flushBuffer();
+};
+
+
+template<size_t BufferSize = BPA_STORE_BUFFER_SIZE>
+class StaticBufferedWriteStream : public BufferedWriteStream {
+public:
+  StaticBufferedWriteStream(Stream& target) : BufferedWriteStream(target, _storage, BufferSize) { }
+
+private:
+  uint8_t _storage[BufferSize];
+};
+
+#endif  // BufferedWriteStream_h
@@ -0,0 +1,428 @@
+/*
+ * ColumnarHistoryBuffer
+ *     A HistoryBuffer that stores each field of its items in a separate ring
+ *     array (structure of arrays) rather than storing whole items. Scanning
+ *     one field, e.g. to find the highest temperature, then walks a dense
+ *     array of that field instead of striding over entire items.
+ *
+ * NOTES:
+ * o The fields that are kept are declared at compile time with a list of
+ *   HBColumn types, most easily written with the HB_COLUMN macro. Fields of
+ *   the item type that aren't listed are not stored. Include the timestamp if
+ *   the item type has one since conditionalPush() and the time range functions
+ *   of HistoryBufferBase depend on it.
+ * o Column values must be trivially copyable (numbers, in practice).
+ * o Every column shares the same head and count. A column is available as at
+ *   most two contiguous segments with column<I>(), and the min/max/sum/mean
+ *   functions run simple loops over those segments that the compiler can
+ *   unroll or vectorize.
+ * o The JSON and binary load/store functions of HistoryBufferBase work as they
+ *   do for HistoryBuffer. Items are reassembled into a scratch item when they
+ *   are read with first(), last(), or peekAt(). The scratch item is reused, so
+ *   the reference is only valid until the next such call, and any field that
+ *   isn't a column (including derived values) has its default value.
+ * o As with HistoryBuffer, a Capacity of 0 means the number of elements comes
+ *   from the descriptor and each column is allocated separately from the heap
+ *   or a BPAAllocator. Otherwise the columns are part of the object.
+ *
+ * Usage:
+ *   ColumnarHistoryBuffer<THPReadings, 0,
+ *       HB_COLUMN(THPReadings, temp),
+ *       HB_COLUMN(THPReadings, humidity),
+ *       HB_COLUMN(THPReadings, pressure),
+ *       HB_COLUMN(THPReadings, timestamp)> history({288, "day", 300});
+ *   ...
+ *   float maxTemp = history.max<0>();
+ *   auto temps = history.column<0>();   // temps.first, then temps.second
+ *
+ */
+
+#ifndef ColumnarHistoryBuffer_h
+#define ColumnarHistoryBuffer_h
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <math.h>
+#include <stdint.h>
+#include <type_traits>
+//                                  Third Party Libraries
+#include <ArduinoLog.h>
+#include <ArduinoJson.h>
+//                                  Local Includes
+#include "BPAAllocator.h"
+#include "BPARingSupport.h"
+#include "HistoryAggregator.h"
+#include "HistoryBuffer.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Column declarations
+ *
+ *----------------------------------------------------------------------------*/
+
+template<typename ItemType, typename FieldType, FieldType ItemType::* Member>
+struct HBColumn {
+  using Item = ItemType;
+  using Type = FieldType;
+
+  static FieldType get(const ItemType& item) { return item.*Member; }
+  static void set(ItemType& item, FieldType value) { item.*Member = value; }
+};
+
+// Declares a column for a member of ItemType, e.g. HB_COLUMN(THPReadings, temp)
+#define HB_COLUMN(ItemType, member) \
+    HBColumn<ItemType, decltype(ItemType::member), &ItemType::member>
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Column storage. Each column in the list adds a layer holding its array.
+ *
+ *----------------------------------------------------------------------------*/
+
+template<typename T, size_t Capacity>
+class HBColumnArray {
+public:
+  T* data() { return _values; }
+  const T* data() const { return _values; }
+  bool allocate(size_t, BPAAllocator&) { return true; }
+  void release() { }
+
+private:
+  T _values[Capacity];
+};
+
+template<typename T>
+class HBColumnArray<T, 0> {
+public:
+  HBColumnArray() = default;
+  HBColumnArray(const HBColumnArray&) = delete;
+  HBColumnArray& operator=(const HBColumnArray&) = delete;
+  ~HBColumnArray() { release(); }
+
+  T* data() { return _values; }
+  const T* data() const { return _values; }
+
+  bool allocate(size_t n, BPAAllocator& allocator) {
+    release();
+    _values = static_cast<T*>(allocator.allocate(n * sizeof(T), alignof(T)));
+    if (_values == nullptr) return false;
+    _allocator = &allocator;
+    _n = n;
+    return true;
+  }
+
+  void release() {
+    if (_allocator) _allocator->deallocate(_values, _n * sizeof(T), alignof(T));
+    _values = nullptr;
+    _allocator = nullptr;
+    _n = 0;
+  }
+
+private:
+  T* _values = nullptr;
+  size_t _n = 0;
+  BPAAllocator* _allocator = nullptr;
+};
+
+
+template<size_t Capacity, typename... Columns>
+class HBColumnStore;
+
+template<size_t Capacity>
+class HBColumnStore<Capacity> {
+public:
+  template<typename ItemType> void scatter(size_t, const ItemType&) { }
+  template<typename ItemType> void gather(size_t, ItemType&) const { }
+  bool allocate(size_t, BPAAllocator&) { return true; }
+  void release() { }
+};
+
+template<size_t Capacity, typename Column, typename... Rest>
+class HBColumnStore<Capacity, Column, Rest...> : public HBColumnStore<Capacity, Rest...> {
+public:
+  using Next = HBColumnStore<Capacity, Rest...>;
+  using Type = typename Column::Type;
+
+  static_assert(std::is_trivially_copyable<Type>::value, "HBColumn fields must be trivially copyable");
+
+  HBColumnArray<Type, Capacity> values;
+
+  template<typename ItemType> void scatter(size_t slot, const ItemType& item) {
+    values.data()[slot] = Column::get(item);
+    Next::scatter(slot, item);
+  }
+
+  template<typename ItemType> void gather(size_t slot, ItemType& item) const {
+    Column::set(item, values.data()[slot]);
+    Next::gather(slot, item);
+  }
+
+  bool allocate(size_t n, BPAAllocator& allocator) {
+    return values.allocate(n, allocator) && Next::allocate(n, allocator);
+  }
+
+  void release() {
+    values.release();
+    Next::release();
+  }
+};
+
+// The layer of Store that holds column I
+template<size_t I, typename Store>
+struct HBColumnLayer {
+  using type = typename HBColumnLayer<I - 1, typename Store::Next>::type;
+};
+
+template<typename Store>
+struct HBColumnLayer<0, Store> {
+  using type = Store;
+};
+
+
+template<typename ItemType, size_t Capacity, typename... Columns>
+class ColumnarHistoryBuffer : public HistoryBufferBase {
+  using Store = HBColumnStore<Capacity, Columns...>;
+  template<size_t I> using Layer = typename HBColumnLayer<I, Store>::type;
+
+public:
+  // The type of the values in column I
+  template<size_t I> using ColumnType = typename Layer<I>::Type;
+
+  static constexpr size_t NColumns = sizeof...(Columns);
+
+/*------------------------------------------------------------------------------
+ *
+ * Construct / Destruct / Initialize
+ *
+ *----------------------------------------------------------------------------*/
+
+  ColumnarHistoryBuffer() = default;
+
+  ColumnarHistoryBuffer(const HBDescriptor& desc, BPAAllocator& allocator = BPAAllocator::heap()) {
+    init(desc, allocator);
+  }
+
+	/**
+	 * Disables copy constructor and assignment operator
+	 */
+  ColumnarHistoryBuffer(const ColumnarHistoryBuffer&) = delete;
+  ColumnarHistoryBuffer& operator=(const ColumnarHistoryBuffer&) = delete;
+
+  // Allocate the columns from allocator. Ignored for a compile-time Capacity.
+  void init(const HBDescriptor& desc, BPAAllocator& allocator = BPAAllocator::heap()) {
+    _name = desc.name;
+    _interval = desc.interval;
+    _head = _count = 0;
+    if (Capacity) return;
+
+    _capacity = desc.nElements;
+    if (!_columns.allocate(_capacity, allocator)) {
+      Log.error(F("ColumnarHistoryBuffer: Unable to allocate %d items for %s"), desc.nElements, desc.name);
+      _columns.release();
+      _capacity = 0;
+    }
+  }
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Member functions that are introduced in this derived class (not in base)
+ *
+ *----------------------------------------------------------------------------*/
+
+  // If there is an aggregator, every item is accumulated and the aggregate
+  // is pushed when the interval closes. Otherwise only the item that closes
+  // the interval is pushed.
+  inline bool conditionalPush(const ItemType& item) {
+    if (_aggregator) _aggregator->accumulate(item);
+    if (item.timestamp - _lastTimeStamp >= _interval) {
+      if (_aggregator) {
+        ItemType aggregate(item);
+        _aggregator->emit(aggregate);
+        _aggregator->reset();
+        push(aggregate);
+      } else {
+        push(item);
+      }
+      _lastTimeStamp = item.timestamp;
+      return true;
+    }
+    return false;
+  }
+
+  void setAggregator(HistoryAggregator<ItemType>* aggregator) {
+    _aggregator = aggregator;
+    if (_aggregator) _aggregator->reset();
+  }
+
+  // Returns false if the oldest item was overwritten to make room
+  bool push(const ItemType& item) {
+    if (_capacity == 0) return false;
+    size_t slot = _head + _count;
+    if (slot >= _capacity) slot -= _capacity;
+    _columns.scatter(slot, item);
+    noteAdded();
+
+    if (_count < _capacity) { _count++; return true; }
+    if (++_head == _capacity) _head = 0;
+    return false;
+  }
+
+  size_t capacity() const { return _capacity; }
+
+  // The values of column I, oldest first, as at most two contiguous segments
+  template<size_t I>
+  bpa::RingSpans<const ColumnType<I>> column() const {
+    return column<I>(0, _count);
+  }
+
+  // n values of column I starting at index, clipped to the items in the buffer
+  template<size_t I>
+  bpa::RingSpans<const ColumnType<I>> column(size_t index, size_t n) const {
+    if (index > _count) index = _count;
+    if (n > _count - index) n = _count - index;
+    size_t start = _head + index;
+    if (start >= _capacity) start -= _capacity;
+    const Layer<I>& layer = _columns;
+    return bpa::makeRingSpans<const ColumnType<I>>(layer.values.data(), _capacity, start, n);
+  }
+
+  // ----- Aggregates over column I. With no index and n they cover the whole
+  // ----- buffer. min() and max() return 0 and mean() returns NAN if there
+  // ----- are no values.
+
+  template<size_t I> ColumnType<I> min(size_t index = 0, size_t n = SIZE_MAX) const {
+    return minOf(column<I>(index, n));
+  }
+
+  template<size_t I> ColumnType<I> max(size_t index = 0, size_t n = SIZE_MAX) const {
+    return maxOf(column<I>(index, n));
+  }
+
+  template<size_t I> double sum(size_t index = 0, size_t n = SIZE_MAX) const {
+    return sumOf(column<I>(index, n));
+  }
+
+  template<size_t I> double mean(size_t index = 0, size_t n = SIZE_MAX) const {
+    bpa::RingSpans<const ColumnType<I>> values = column<I>(index, n);
+    return values.empty() ? NAN : sumOf(values) / values.size();
+  }
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Implementation of the HistoryBufferBase interface
+ *
+ *----------------------------------------------------------------------------*/
+
+  virtual size_t size() const override { return _count; }
+  virtual const ItemType& first() const override { return peekAt(0); }
+  virtual const ItemType& last() const override { return peekAt(_count - 1); }
+
+  virtual const ItemType& peekAt(size_t index) const override {
+    size_t slot = _head + index;
+    if (slot >= _capacity) slot -= _capacity;
+    _columns.gather(slot, _scratch);
+    return _scratch;
+  }
+
+  virtual void clear() override {
+    _head = _count = 0;
+    if (_aggregator) _aggregator->reset();
+    noteCleared();
+  }
+
+  virtual void push(JsonObjectConst jsonItem) override {
+    ItemType item;
+    item.internalize(jsonItem);
+    push(item);
+  }
+
+  virtual bool push(const Serializable& item) override {
+    return push(static_cast<const ItemType&>(item));
+  }
+
+  virtual bool conditionalPush(const Serializable& item) override {
+    return conditionalPush(static_cast<const ItemType&>(item));
+  }
+
+  virtual size_t itemBinarySize() const override { return ItemType().binarySize(); }
+
+  virtual void pushBinary(const uint8_t* record) override {
+    ItemType item;
+    item.fromBinary(record);
+    push(item);
+  }
+
+protected:
+  // Reassemble and write the items without a virtual call per item
+  virtual void storeItems(JsonWriter& writer) const override { storeItems(writer, 0, _count); }
+
+  virtual void storeItems(JsonWriter& writer, size_t index, size_t n) const override {
+    ItemType item;
+    size_t slot = _head + index;
+    if (slot >= _capacity) slot -= _capacity;
+    for (size_t i = 0; i < n; i++) {
+      _columns.gather(slot, item);
+      item.ItemType::externalizeTo(writer);
+      if (++slot == _capacity) slot = 0;
+    }
+  }
+
+  // The same search as the base class, but on ItemType's timestamp
+  virtual size_t indexAfter(time_t t) const override {
+    size_t low = 0, high = _count;
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (static_cast<time_t>(peekAt(mid).timestamp) <= t) low = mid + 1;
+      else high = mid;
+    }
+    return low;
+  }
+
+  virtual time_t newestTimestamp() const override { return _count ? last().timestamp : 0; }
+
+private:
+  static_assert(std::is_base_of<Serializable, ItemType>::value, "HistoryBuffer Item must derive from Serializable");
+  static_assert(sizeof...(Columns) > 0, "ColumnarHistoryBuffer needs at least one column");
+
+  Store _columns;
+  size_t _capacity = Capacity;
+  size_t _head = 0;       // The slot holding the oldest item
+  size_t _count = 0;
+  mutable ItemType _scratch;
+  HistoryAggregator<ItemType>* _aggregator = nullptr;
+
+  // ----- Kernels. Each segment is a plain contiguous loop.
+
+  template<typename T> static T minOf(const bpa::RingSpans<const T>& values) {
+    if (values.empty()) return T();
+    T m = values.first[0];
+    for (T v : values.first) m = (v < m) ? v : m;
+    for (T v : values.second) m = (v < m) ? v : m;
+    return m;
+  }
+
+  template<typename T> static T maxOf(const bpa::RingSpans<const T>& values) {
+    if (values.empty()) return T();
+    T m = values.first[0];
+    for (T v : values.first) m = (v > m) ? v : m;
+    for (T v : values.second) m = (v > m) ? v : m;
+    return m;
+  }
+
+  template<typename T> static double sumOf(const bpa::RingSpans<const T>& values) {
+    return sumOf(values.first) + sumOf(values.second);
+  }
+
+  template<typename T> static double sumOf(bpa::span<const T> values) {
+    double s = 0;
+    for (T v : values) s += v;
+    return s;
+  }
+};
+
+#endif  // ColumnarHistoryBuffer_h
@@ -0,0 +1,461 @@
+/*
+ * CompressedHistoryBuffer
+ *     A HistoryBuffer that keeps its items compressed in memory so that long
+ *     tiers (a week or a month of readings) fit in a fraction of the space.
+ *
+ * NOTES:
+ * o The fields that are kept are declared with HBColumn types, as for
+ *   ColumnarHistoryBuffer. The first column is the timestamp, which must be
+ *   an integer. The rest must be 32-bit values (floats, in practice).
+ * o Timestamps are delta-of-delta encoded and values are XOR encoded (see
+ *   HistoryCompression.h). For readings taken at a regular interval that
+ *   change slowly, an item typically takes a few bytes instead of the size
+ *   of the whole object.
+ * o Items are packed into fixed size blocks of BlockSize bytes. Each block
+ *   starts with an uncompressed item so that it can be decoded on its own.
+ *   The buffer holds a fixed number of blocks, taken from the nElements
+ *   field of the descriptor. When a new block is needed and they are all in
+ *   use, the oldest block, and every item in it, is dropped.
+ * o Since the number of items per block depends on the data, so does the
+ *   number of items the buffer can hold.
+ * o Items are decoded sequentially. Walk them with begin()/end() or a
+ *   Cursor. peekAt() remembers where it left off, so calling it with
+ *   ascending indices (as store() does) is also sequential. Otherwise it
+ *   decodes from the start of the block that holds the item.
+ * o first(), last(), and peekAt() reassemble the item in a scratch item that
+ *   is reused, so the reference is only valid until the next such call. Any
+ *   field that isn't a column (including derived values) has its default value.
+ *
+ * Usage:
+ *   CompressedHistoryBuffer<THPReadings, 128,
+ *       HB_COLUMN(THPReadings, timestamp),
+ *       HB_COLUMN(THPReadings, temp),
+ *       HB_COLUMN(THPReadings, humidity),
+ *       HB_COLUMN(THPReadings, pressure)> week({64, "week", 300});   // 64 blocks
+ *   ...
+ *   for (const THPReadings& r : week) chart.addPoint(r.timestamp, r.temp);
+ *
+ */
+
+#ifndef CompressedHistoryBuffer_h
+#define CompressedHistoryBuffer_h
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <stdint.h>
+#include <string.h>
+#include <iterator>
+#include <type_traits>
+//                                  Third Party Libraries
+#include <ArduinoLog.h>
+#include <ArduinoJson.h>
+//                                  Local Includes
+#include "BPAAllocator.h"
+#include "BPACircularBuffer.h"
+#include "ColumnarHistoryBuffer.h"
+#include "HistoryAggregator.h"
+#include "HistoryBuffer.h"
+#include "HistoryCompression.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+// Moves the values of a list of 32-bit columns between an item and an array
+template<typename... Columns>
+struct HBValueColumns {
+  template<typename ItemType> static void get(const ItemType&, uint32_t*) { }
+  template<typename ItemType> static void set(ItemType&, const uint32_t*) { }
+};
+
+template<typename Column, typename... Rest>
+struct HBValueColumns<Column, Rest...> {
+  static_assert(sizeof(typename Column::Type) == 4, "Compressed value columns must be 32 bits");
+  static_assert(std::is_trivially_copyable<typename Column::Type>::value, "HBColumn fields must be trivially copyable");
+
+  template<typename ItemType> static void get(const ItemType& item, uint32_t* bits) {
+    typename Column::Type value = Column::get(item);
+    memcpy(bits, &value, 4);
+    HBValueColumns<Rest...>::get(item, bits + 1);
+  }
+
+  template<typename ItemType> static void set(ItemType& item, const uint32_t* bits) {
+    typename Column::Type value;
+    memcpy(&value, bits, 4);
+    Column::set(item, value);
+    HBValueColumns<Rest...>::set(item, bits + 1);
+  }
+};
+
+
+template<typename ItemType, size_t BlockSize, typename TimeColumn, typename... ValueColumns>
+class CompressedHistoryBuffer : public HistoryBufferBase {
+  using TimeType = typename TimeColumn::Type;
+  using Values = HBValueColumns<ValueColumns...>;
+
+public:
+  static constexpr size_t NValues = sizeof...(ValueColumns);
+
+  // The encoder state after an item, which is also the decoder state
+  struct Codec {
+    int64_t timestamp;
+    int64_t delta;
+    HistoryCompression::XorState values[NValues];
+  };
+
+  struct Block {
+    uint16_t nItems;
+    uint16_t nBits;
+    uint8_t data[BlockSize];
+  };
+
+  // Decodes the items in order starting from a given index
+  class Cursor {
+  public:
+    Cursor() = default;
+
+    // Decode the next item into item. Returns false when there are no more.
+    bool next(ItemType& item) {
+      if (_buffer == nullptr || _index >= _buffer->_count) return false;
+      const Block* block = &_buffer->_blocks.peekAt(_block);
+      if (_itemInBlock == block->nItems) {
+        block = &_buffer->_blocks.peekAt(++_block);
+        _itemInBlock = 0;
+      }
+      if (_itemInBlock == 0) _reader = HistoryCompression::BitReader(block->data);
+      _buffer->decode(_reader, _codec, _itemInBlock == 0);
+      _itemInBlock++;
+      _index++;
+      _buffer->assemble(_codec, item);
+      return true;
+    }
+
+    // The index of the item that next() will return
+    size_t index() const { return _index; }
+
+  private:
+    friend class CompressedHistoryBuffer;
+
+    const CompressedHistoryBuffer* _buffer = nullptr;
+    size_t _index = 0;
+    size_t _block = 0;
+    size_t _itemInBlock = 0;
+    HistoryCompression::BitReader _reader;
+    Codec _codec;
+  };
+
+  // A forward iterator that decodes as it goes
+  class const_iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ItemType;
+    using difference_type = ptrdiff_t;
+    using pointer = const ItemType*;
+    using reference = const ItemType&;
+
+    const_iterator(const Cursor& cursor, bool atEnd) : _cursor(cursor), _atEnd(atEnd) {
+      if (!_atEnd) ++(*this);
+    }
+
+    reference operator*() const { return _item; }
+    pointer operator->() const { return &_item; }
+    const_iterator& operator++() { _atEnd = !_cursor.next(_item); return *this; }
+
+    bool operator==(const const_iterator& other) const { return _atEnd == other._atEnd; }
+    bool operator!=(const const_iterator& other) const { return _atEnd != other._atEnd; }
+
+  private:
+    Cursor _cursor;
+    ItemType _item;
+    bool _atEnd;
+  };
+
+/*------------------------------------------------------------------------------
+ *
+ * Construct / Destruct / Initialize
+ *
+ *----------------------------------------------------------------------------*/
+
+  CompressedHistoryBuffer() = default;
+
+  CompressedHistoryBuffer(const HBDescriptor& desc, BPAAllocator& allocator = BPAAllocator::heap()) {
+    init(desc, allocator);
+  }
+
+  // desc.nElements is the number of blocks, not the number of items
+  void init(const HBDescriptor& desc, BPAAllocator& allocator = BPAAllocator::heap()) {
+    _name = desc.name;
+    _interval = desc.interval;
+    _count = 0;
+    _cursorValid = false;
+    if (!_blocks.init(desc.nElements, allocator)) {
+      Log.error(F("CompressedHistoryBuffer: Unable to allocate %d blocks for %s"), desc.nElements, desc.name);
+    }
+  }
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Member functions that are introduced in this derived class (not in base)
+ *
+ *----------------------------------------------------------------------------*/
+
+  // If there is an aggregator, every item is accumulated and the aggregate
+  // is pushed when the interval closes. Otherwise only the item that closes
+  // the interval is pushed.
+  inline bool conditionalPush(const ItemType& item) {
+    if (_aggregator) _aggregator->accumulate(item);
+    if (item.timestamp - _lastTimeStamp >= _interval) {
+      if (_aggregator) {
+        ItemType aggregate(item);
+        _aggregator->emit(aggregate);
+        _aggregator->reset();
+        push(aggregate);
+      } else {
+        push(item);
+      }
+      _lastTimeStamp = item.timestamp;
+      return true;
+    }
+    return false;
+  }
+
+  void setAggregator(HistoryAggregator<ItemType>* aggregator) {
+    _aggregator = aggregator;
+    if (_aggregator) _aggregator->reset();
+  }
+
+  // Returns false if the oldest block was dropped to make room
+  bool push(const ItemType& item) {
+    if (_blocks.capacity() == 0) return false;
+    _cursorValid = false;
+
+    int64_t timestamp = static_cast<int64_t>(TimeColumn::get(item));
+    uint32_t values[NValues];
+    Values::get(item, values);
+
+    // Append to the newest block if the item fits, otherwise start a new one
+    if (!_blocks.isEmpty()) {
+      Block& block = _blocks.back();
+      Codec codec = _tail;
+      HistoryCompression::BitWriter writer(block.data, block.nBits, BlockSize * 8);
+      if (encode(writer, codec, false, timestamp, values)) {
+        block.nBits = writer.position();
+        block.nItems++;
+        _tail = codec;
+        added();
+        return true;
+      }
+    }
+
+    bool dropped = _blocks.isFull();
+    if (dropped) _count -= _blocks.front().nItems;
+    _blocks.emplace();
+    Block& block = _blocks.back();
+    HistoryCompression::BitWriter writer(block.data, 0, BlockSize * 8);
+    encode(writer, _tail, true, timestamp, values);
+    block.nBits = writer.position();
+    block.nItems = 1;
+    added();
+    return !dropped;
+  }
+
+  // The items from index on, in order
+  Cursor cursor(size_t index = 0) const {
+    Cursor c;
+    c._buffer = this;
+    seek(c, index);
+    return c;
+  }
+
+  const_iterator begin() const { return const_iterator(cursor(), _count == 0); }
+  const_iterator end() const { return const_iterator(Cursor(), true); }
+
+  size_t blockCount() const { return _blocks.size(); }
+  size_t blockCapacity() const { return _blocks.capacity(); }
+
+  // Bytes of compressed data, not counting unused space at the end of blocks
+  size_t compressedSize() const {
+    size_t bits = 0;
+    for (size_t i = 0; i < _blocks.size(); i++) bits += _blocks.peekAt(i).nBits;
+    return (bits + 7) / 8;
+  }
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Implementation of the HistoryBufferBase interface
+ *
+ *----------------------------------------------------------------------------*/
+
+  virtual size_t size() const override { return _count; }
+  virtual const ItemType& first() const override { return peekAt(0); }
+
+  // The newest item is always available from the encoder state
+  virtual const ItemType& last() const override {
+    assemble(_tail, _lastItem);
+    return _lastItem;
+  }
+
+  virtual const ItemType& peekAt(size_t index) const override {
+    if (!_cursorValid || _cursor.index() != index) {
+      _cursor._buffer = this;
+      seek(_cursor, index);
+      _cursorValid = true;
+    }
+    _cursor.next(_scratch);
+    return _scratch;
+  }
+
+  virtual void clear() override {
+    _blocks.clear();
+    _count = 0;
+    _cursorValid = false;
+    if (_aggregator) _aggregator->reset();
+    noteCleared();
+  }
+
+  virtual void push(JsonObjectConst jsonItem) override {
+    ItemType item;
+    item.internalize(jsonItem);
+    push(item);
+  }
+
+  virtual bool push(const Serializable& item) override {
+    return push(static_cast<const ItemType&>(item));
+  }
+
+  virtual bool conditionalPush(const Serializable& item) override {
+    return conditionalPush(static_cast<const ItemType&>(item));
+  }
+
+  virtual size_t itemBinarySize() const override { return ItemType().binarySize(); }
+
+  virtual void pushBinary(const uint8_t* record) override {
+    ItemType item;
+    item.fromBinary(record);
+    push(item);
+  }
+
+protected:
+  // Decode the items in one pass, without a virtual call per item
+  virtual void storeItems(JsonWriter& writer) const override { storeItems(writer, 0, _count); }
+
+  virtual void storeItems(JsonWriter& writer, size_t index, size_t n) const override {
+    Cursor c = cursor(index);
+    ItemType item;
+    for (size_t i = 0; i < n && c.next(item); i++) item.ItemType::externalizeTo(writer);
+  }
+
+  // The same search as the base class, but on ItemType's timestamp
+  virtual size_t indexAfter(time_t t) const override {
+    size_t low = 0, high = _count;
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (static_cast<time_t>(peekAt(mid).timestamp) <= t) low = mid + 1;
+      else high = mid;
+    }
+    return low;
+  }
+
+  virtual time_t newestTimestamp() const override { return _count ? last().timestamp : 0; }
+
+private:
+  static_assert(std::is_base_of<Serializable, ItemType>::value, "HistoryBuffer Item must derive from Serializable");
+  static_assert(std::is_integral<TimeType>::value, "The first column must be an integer timestamp");
+  static_assert(BlockSize * 8 <= UINT16_MAX, "BlockSize is too large");
+
+  static constexpr uint8_t TimeBits = sizeof(TimeType) * 8;
+  static_assert(BlockSize * 8 >= TimeBits + NValues * 32, "BlockSize is too small for one item");
+
+  BPACircularBuffer<Block> _blocks;
+  size_t _count = 0;
+  Codec _tail;                    // The encoder state after the newest item
+  HistoryAggregator<ItemType>* _aggregator = nullptr;
+
+  mutable Cursor _cursor;         // Where peekAt() left off
+  mutable bool _cursorValid = false;
+  mutable ItemType _scratch;
+  mutable ItemType _lastItem;
+
+  void added() {
+    _count++;
+    noteAdded();
+  }
+
+  // The first item of a block is stored raw. Returns false if the item
+  // didn't fit, in which case codec is no longer valid.
+  bool encode(
+      HistoryCompression::BitWriter& out, Codec& codec, bool first,
+      int64_t timestamp, const uint32_t* values) const
+  {
+    if (first) {
+      uint64_t raw = static_cast<uint64_t>(timestamp);
+      if (TimeBits > 32) out.write(static_cast<uint32_t>(raw >> 32), TimeBits - 32);
+      out.write(static_cast<uint32_t>(raw), TimeBits > 32 ? 32 : TimeBits);
+      codec.timestamp = timestamp;
+      codec.delta = 0;
+      for (size_t i = 0; i < NValues; i++) {
+        out.write(values[i], 32);
+        codec.values[i].start(values[i]);
+      }
+      return !out.overflowed();
+    }
+
+    int64_t delta = timestamp - codec.timestamp;
+    int64_t deltaOfDelta = delta - codec.delta;
+    if (deltaOfDelta > HistoryCompression::MaxDelta || deltaOfDelta < HistoryCompression::MinDelta) {
+      return false;   // Start a new block with this item stored raw
+    }
+    HistoryCompression::writeDelta(out, static_cast<int32_t>(deltaOfDelta));
+    codec.timestamp = timestamp;
+    codec.delta = delta;
+    for (size_t i = 0; i < NValues; i++) HistoryCompression::writeXor(out, codec.values[i], values[i]);
+    return !out.overflowed();
+  }
+
+  void decode(HistoryCompression::BitReader& in, Codec& codec, bool first) const {
+    if (first) {
+      uint64_t raw = 0;
+      if (TimeBits > 32) raw = static_cast<uint64_t>(in.read(TimeBits - 32)) << 32;
+      raw |= in.read(TimeBits > 32 ? 32 : TimeBits);
+      codec.timestamp = static_cast<int64_t>(static_cast<TimeType>(raw));
+      codec.delta = 0;
+      for (size_t i = 0; i < NValues; i++) codec.values[i].start(in.read(32));
+      return;
+    }
+
+    codec.delta += HistoryCompression::readDelta(in);
+    codec.timestamp += codec.delta;
+    for (size_t i = 0; i < NValues; i++) HistoryCompression::readXor(in, codec.values[i]);
+  }
+
+  void assemble(const Codec& codec, ItemType& item) const {
+    uint32_t values[NValues];
+    for (size_t i = 0; i < NValues; i++) values[i] = codec.values[i].previous;
+    TimeColumn::set(item, static_cast<TimeType>(codec.timestamp));
+    Values::set(item, values);
+  }
+
+  // Position c so that next() returns item index. Items before it in the
+  // same block have to be decoded along the way.
+  void seek(Cursor& c, size_t index) const {
+    c._block = 0;
+    c._itemInBlock = 0;
+    c._index = 0;
+    if (index >= _count) { c._index = _count; return; }
+
+    while (index >= _blocks.peekAt(c._block).nItems) {
+      index -= _blocks.peekAt(c._block).nItems;
+      c._index += _blocks.peekAt(c._block).nItems;
+      c._block++;
+    }
+
+    c._reader = HistoryCompression::BitReader(_blocks.peekAt(c._block).data);
+    for (size_t i = 0; i < index; i++) {
+      decode(c._reader, c._codec, i == 0);
+      c._itemInBlock++;
+      c._index++;
+    }
+  }
+};
+
+#endif  // CompressedHistoryBuffer_h
@@ -0,0 +1,117 @@
+/*
+ * ConcurrentHistoryBuffer
+ *     Wraps a HistoryBuffer so that one task can push items while other tasks
+ *     read them, without either side taking a lock. This is meant for the
+ *     ESP32, where e.g. a sensor task adds readings and the web server task
+ *     renders charts from them.
+ *
+ * NOTES:
+ * o Writers (push, conditionalPush, clear, modify) bump a sequence counter
+ *   before and after changing the buffer. The counter is odd while a change
+ *   is in progress. If there are several writers they take turns, but a
+ *   writer never waits for a reader.
+ * o Readers copy a range of items with snapshot() and then check the counter.
+ *   If a writer was active at any point during the copy, they discard it and
+ *   retry. A push publishes the new size before it fills the new slot, so no
+ *   copy that overlaps a write can be trusted, even one of untouched items.
+ * o Readers give up, and copy nothing, after a limited number of retries. They
+ *   back off between retries so that they can't starve a writer, but readers
+ *   should run at the same priority as the writer or lower. See BPASeqLock.h.
+ * o The copy may race with a writer, which is why it is checked afterwards.
+ *   ItemType must therefore be safe to copy while it is being overwritten and
+ *   then discard: plain values, not pointers to memory the item owns.
+ * o Everything else (store, load, statistics, ...) goes through modify() for
+ *   writers or buffer() for code that runs on the writer's task.
+ *
+ * Usage:
+ *   ConcurrentHistoryBuffer<THPReadings> history({288, "day", 300});
+ *   // Sensor task
+ *   history.conditionalPush(reading);
+ *   // Web server task
+ *   THPReadings recent[48];
+ *   size_t n = history.snapshotNewest(48, recent);
+ *
+ */
+
+#ifndef ConcurrentHistoryBuffer_h
+#define ConcurrentHistoryBuffer_h
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <Arduino.h>
+//                                  Local Includes
+#include "BPASeqLock.h"
+#include "HistoryBuffer.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+template<typename ItemType, size_t Capacity = 0>
+class ConcurrentHistoryBuffer {
+public:
+  ConcurrentHistoryBuffer() = default;
+
+  ConcurrentHistoryBuffer(const HBDescriptor& desc, ItemType* space = nullptr) : _buffer(desc, space) { }
+
+  ConcurrentHistoryBuffer(const HBDescriptor& desc, BPAAllocator& allocator) : _buffer(desc, allocator) { }
+
+  // ----- Writers
+
+  bool push(const ItemType& item) {
+    _lock.beginWrite();
+    bool added = _buffer.push(item);
+    _lock.endWrite();
+    return added;
+  }
+
+  bool conditionalPush(const ItemType& item) {
+    _lock.beginWrite();
+    bool pushed = _buffer.conditionalPush(item);
+    _lock.endWrite();
+    return pushed;
+  }
+
+  void clear() {
+    _lock.beginWrite();
+    _buffer.clear();
+    _lock.endWrite();
+  }
+
+  // Make some other change to the buffer, e.g. load it. Readers that are
+  // waiting for f to return may run out of retries, so keep it short.
+  template<typename F>
+  void modify(F f) {
+    _lock.beginWrite();
+    f(_buffer);
+    _lock.endWrite();
+  }
+
+  // ----- Readers
+
+  // Copy up to n items, starting with the one at index, into dest. Returns the
+  // number copied. The items are a consistent view of the buffer at one moment.
+  // Returns 0 if writers kept getting in the way.
+  size_t snapshot(size_t index, size_t n, ItemType* dest) const {
+    return _lock.snapshot(_buffer, index, n, dest, false);
+  }
+
+  // Copy the newest n (or fewer) items into dest, oldest first
+  size_t snapshotNewest(size_t n, ItemType* dest) const {
+    return _lock.snapshot(_buffer, 0, n, dest, true);
+  }
+
+  // These are only a hint when other tasks are writing
+  size_t size() const { return _buffer.size(); }
+  size_t capacity() const { return _buffer.capacity(); }
+
+  // Changes each time a writer changes the buffer
+  uint32_t sequence() const { return _lock.sequence(); }
+
+  // Direct access for code that runs on the writer's task, or when no one is writing
+  const HistoryBuffer<ItemType, Capacity>& buffer() const { return _buffer; }
+
+private:
+  HistoryBuffer<ItemType, Capacity> _buffer;
+  BPASeqLock _lock;
+};
+
+#endif  // ConcurrentHistoryBuffer_h
@@ -0,0 +1,82 @@
+/*
+ * HistoryActions
+ *     Actions that store or load a HistoryBuffers object a slice at a time
+ *     under the control of the ActionManager, so that a large history can be
+ *     written or read without blocking loop() for long.
+ *
+ * NOTES:
+ * o Each call to process() does one step (see HistoryBuffers::stepStore and
+ *   stepLoad) of at most budgetMicros, then asks to be resumed after pause ms.
+ * o If an action is halted part way through, the next process() starts over.
+ *   An unfinished store never replaces the existing file.
+ *
+ * Usage:
+ *   HistoryStoreAction<HistoryBuffers<THPReadings, 3>> saveHistory(history, "/history.json");
+ *   ...
+ *   SequenceAction root(Actions{&saveHistory, ...}, 0);
+ *   ActionMgr.begin(&root);
+ *
+ */
+
+#ifndef HistoryActions_h
+#define HistoryActions_h
+
+#include <Arduino.h>
+#include "ActionManager.h"
+
+template<typename Buffers>
+class HistoryStoreAction : public Action {
+public:
+  static constexpr uint32_t DefaultBudget = 5000;   // Microseconds per step
+
+  HistoryStoreAction(Buffers& buffers, const String& path, uint32_t budgetMicros = DefaultBudget, int32_t pause = 0)
+    : m_buffers(buffers), m_path(path), m_budget(budgetMicros), m_pause(pause) { }
+
+  virtual Action::Result process() override {
+    if (!m_started) {
+      if (!m_buffers.beginStore(m_path)) return ActionCompleted;
+      m_started = true;
+    }
+    if (m_buffers.stepStore(m_budget)) return Result(m_pause);
+
+    m_buffers.finishStore();
+    m_started = false;
+    return ActionCompleted;
+  }
+
+private:
+  Buffers& m_buffers;
+  String m_path;
+  uint32_t m_budget;  // How long each step may take
+  int32_t m_pause;    // How long to pause between steps
+};
+
+
+template<typename Buffers>
+class HistoryLoadAction : public Action {
+public:
+  static constexpr uint32_t DefaultBudget = 5000;   // Microseconds per step
+
+  HistoryLoadAction(Buffers& buffers, const String& path, uint32_t budgetMicros = DefaultBudget, int32_t pause = 0)
+    : m_buffers(buffers), m_path(path), m_budget(budgetMicros), m_pause(pause) { }
+
+  virtual Action::Result process() override {
+    if (!m_started) {
+      if (!m_buffers.beginLoad(m_path)) return ActionCompleted;
+      m_started = true;
+    }
+    if (m_buffers.stepLoad(m_budget)) return Result(m_pause);
+
+    m_buffers.finishLoad();
+    m_started = false;
+    return ActionCompleted;
+  }
+
+private:
+  Buffers& m_buffers;
+  String m_path;
+  uint32_t m_budget;  // How long each step may take
+  int32_t m_pause;    // How long to pause between steps
+};
+
+#endif  // HistoryActions_h
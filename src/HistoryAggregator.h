@@ -0,0 +1,133 @@
+/*
+ * HistoryAggregator
+ *     Summarizes all of the items offered to a HistoryBuffer during one of its
+ *     intervals so that the item it finally keeps represents the whole interval
+ *     rather than whichever reading happened to arrive when the interval closed.
+ *
+ * NOTES:
+ * o An aggregator is attached to a HistoryBuffer with setAggregator(). From then
+ *   on, every item given to conditionalPush() is accumulated, and when the
+ *   interval closes the aggregated item is pushed in place of the raw one.
+ * o Aggregation is incremental. The state is a fixed size, regardless of how
+ *   many items arrive in an interval, and nothing is ever re-scanned.
+ * o FieldAggregator handles the common case of items whose interesting values
+ *   are float members. For each field it tracks min/max/sum/count and writes a
+ *   chosen statistic into the emitted item. Since a statistic may be written to
+ *   a different field than it was computed from, an item type with (say)
+ *   tempMin and tempMax members can capture the extremes as well as the mean.
+ * o The emitted item starts as a copy of the item that closed the interval, so
+ *   its timestamp and any fields that aren't aggregated come from that item.
+ *   Values that are derived from aggregated fields are not recalculated.
+ * o An aggregator holds the state for one buffer. Give each buffer its own.
+ *
+ * Usage:
+ *   FieldAggregator<THPReadings, 3> dayRollup({
+ *     {&THPReadings::temp}, {&THPReadings::humidity}, {&THPReadings::pressure}
+ *   });
+ *   history.getMutable(1).setAggregator(&dayRollup);
+ *
+ */
+
+#ifndef HistoryAggregator_h
+#define HistoryAggregator_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <float.h>
+#include <initializer_list>
+
+
+template<typename ItemType>
+class HistoryAggregator {
+public:
+  virtual ~HistoryAggregator() { }
+
+  // Forget everything accumulated so far and start a new interval
+  virtual void reset() = 0;
+
+  // Add an item to the current interval
+  virtual void accumulate(const ItemType& item) = 0;
+
+  // Write the summary of the current interval into result. At least one item
+  // will have been accumulated.
+  virtual void emit(ItemType& result) const = 0;
+};
+
+
+struct FieldStats {
+  float min = FLT_MAX;
+  float max = -FLT_MAX;
+  float sum = 0;
+  uint32_t count = 0;
+
+  void reset() { *this = FieldStats(); }
+
+  void add(float value) {
+    if (value < min) min = value;
+    if (value > max) max = value;
+    sum += value;
+    count++;
+  }
+
+  float mean() const { return count ? sum / count : 0; }
+};
+
+
+enum class HBStatistic : uint8_t { Mean, Min, Max, Sum, Count };
+
+template<typename ItemType, size_t NFields>
+class FieldAggregator : public HistoryAggregator<ItemType> {
+public:
+  using FloatField = float ItemType::*;
+
+  struct Field {
+    Field() = default;
+    Field(FloatField f, HBStatistic s = HBStatistic::Mean) : source(f), statistic(s), dest(f) { }
+    Field(FloatField src, HBStatistic s, FloatField dst) : source(src), statistic(s), dest(dst) { }
+
+    FloatField source = nullptr;  // The member whose values are accumulated
+    HBStatistic statistic = HBStatistic::Mean;
+    FloatField dest = nullptr;    // The member of the emitted item that receives the statistic
+  };
+
+  // Any fields beyond NFields are ignored
+  FieldAggregator(std::initializer_list<Field> fields) {
+    for (const Field& f : fields) {
+      if (_nFields == NFields) break;
+      _fields[_nFields++] = f;
+    }
+  }
+
+  virtual void reset() override {
+    for (size_t i = 0; i < _nFields; i++) _stats[i].reset();
+  }
+
+  virtual void accumulate(const ItemType& item) override {
+    for (size_t i = 0; i < _nFields; i++) _stats[i].add(item.*(_fields[i].source));
+  }
+
+  virtual void emit(ItemType& result) const override {
+    for (size_t i = 0; i < _nFields; i++) {
+      const FieldStats& s = _stats[i];
+      float value;
+      switch (_fields[i].statistic) {
+        case HBStatistic::Min:   value = s.min; break;
+        case HBStatistic::Max:   value = s.max; break;
+        case HBStatistic::Sum:   value = s.sum; break;
+        case HBStatistic::Count: value = s.count; break;
+        default:                 value = s.mean(); break;
+      }
+      result.*(_fields[i].dest) = value;
+    }
+  }
+
+  // The statistics accumulated so far in the current interval
+  const FieldStats& stats(size_t fieldIndex) const { return _stats[fieldIndex]; }
+
+private:
+  Field _fields[NFields];
+  FieldStats _stats[NFields];
+  size_t _nFields = 0;
+};
+
+#endif  // HistoryAggregator_h
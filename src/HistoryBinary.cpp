@@ -0,0 +1,143 @@
+/*
+ * HistoryBinary.cpp
+ *
+ */
+
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <string.h>
+//                                  Third Party Libraries
+#include <ArduinoLog.h>
+//                                  Personal Libraries
+//                                  App Libraries and Includes
+#include "HistoryBinary.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+namespace HistoryBinary {
+  namespace internal {
+    const uint8_t Magic[4] = { 'B', 'P', 'A', 'H' };
+    constexpr size_t FileHeaderSize = 8;
+
+    // CRC-32 (as used by zip and Ethernet), computed a nibble at a time to
+    // keep the table small
+    const uint32_t CRCNibbleTable[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+      0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+    };
+
+    inline void putU16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+    inline void putU32(uint8_t* p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+    inline uint16_t getU16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+    inline uint32_t getU32(const uint8_t* p) {
+      return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    bool writeAll(Print& out, const uint8_t* data, size_t length) {
+      return out.write(data, length) == length;
+    }
+
+    bool readAll(Stream& in, uint8_t* data, size_t length) {
+      return in.readBytes(data, length) == length;
+    }
+  };
+
+  uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc) {
+    crc = ~crc;
+    while (length--) {
+      crc ^= *data++;
+      crc = (crc >> 4) ^ internal::CRCNibbleTable[crc & 0x0f];
+      crc = (crc >> 4) ^ internal::CRCNibbleTable[crc & 0x0f];
+    }
+    return ~crc;
+  }
+
+  bool writeFileHeader(Print& out, uint8_t nTiers) {
+    uint8_t header[internal::FileHeaderSize] = { 0 };
+    memcpy(header, internal::Magic, sizeof(internal::Magic));
+    header[4] = Version;
+    header[5] = nTiers;
+    return internal::writeAll(out, header, sizeof(header));
+  }
+
+  bool readFileHeader(Stream& in, uint8_t& nTiers) {
+    uint8_t header[internal::FileHeaderSize];
+    if (!internal::readAll(in, header, sizeof(header))) return false;
+    if (memcmp(header, internal::Magic, sizeof(internal::Magic)) != 0) {
+      Log.warning(F("HistoryBinary: Not a binary history file"));
+      return false;
+    }
+    if (header[4] != Version) {
+      Log.warning(F("HistoryBinary: Unsupported version: %d"), header[4]);
+      return false;
+    }
+    nTiers = header[5];
+    return true;
+  }
+
+  bool writeTierHeader(Print& out, const TierHeader& header) {
+    uint8_t buf[1 + MaxNameSize + 4 + 4 + 2 + 4];
+    uint8_t nameLength = strnlen(header.name, MaxNameSize - 1);
+    uint8_t* p = buf;
+    *p++ = nameLength;
+    memcpy(p, header.name, nameLength); p += nameLength;
+    internal::putU32(p, header.interval); p += 4;
+    internal::putU32(p, header.count); p += 4;
+    internal::putU16(p, header.recordSize); p += 2;
+    internal::putU32(p, crc32(buf, p - buf)); p += 4;
+    return internal::writeAll(out, buf, p - buf);
+  }
+
+  bool readTierHeader(Stream& in, TierHeader& header) {
+    uint8_t buf[1 + 255 + 4 + 4 + 2 + 4];
+    if (!internal::readAll(in, buf, 1)) return false;
+    uint8_t nameLength = buf[0];
+    size_t remaining = nameLength + 4 + 4 + 2 + 4;
+    if (!internal::readAll(in, buf + 1, remaining)) return false;
+
+    const uint8_t* p = buf + 1 + nameLength;
+    if (internal::getU32(p + 10) != crc32(buf, 1 + nameLength + 10)) {
+      Log.warning(F("HistoryBinary: Corrupt tier header"));
+      return false;
+    }
+
+    size_t copied = (nameLength < MaxNameSize) ? nameLength : MaxNameSize - 1;
+    memcpy(header.name, buf + 1, copied);
+    header.name[copied] = '\0';
+    header.interval = internal::getU32(p);
+    header.count = internal::getU32(p + 4);
+    header.recordSize = internal::getU16(p + 8);
+    return true;
+  }
+
+  bool writeBlock(Print& out, const uint8_t* records, size_t nBytes) {
+    uint8_t crc[4];
+    internal::putU32(crc, crc32(records, nBytes));
+    return internal::writeAll(out, records, nBytes) && internal::writeAll(out, crc, sizeof(crc));
+  }
+
+  bool readBlock(Stream& in, uint8_t* records, size_t nBytes) {
+    uint8_t crc[4];
+    if (!internal::readAll(in, records, nBytes) || !internal::readAll(in, crc, sizeof(crc))) {
+      return false;
+    }
+    return internal::getU32(crc) == crc32(records, nBytes);
+  }
+
+  bool skipTier(Stream& in, const TierHeader& header) {
+    if (header.count == 0) return true;
+    size_t perBlock = recordsPerBlock(header.recordSize);
+    if (perBlock == 0) return false;
+
+    size_t nBlocks = (header.count + perBlock - 1) / perBlock;
+    size_t remaining = header.count * header.recordSize + nBlocks * 4;
+    uint8_t scratch[32];
+    while (remaining) {
+      size_t n = (remaining < sizeof(scratch)) ? remaining : sizeof(scratch);
+      if (!internal::readAll(in, scratch, n)) return false;
+      remaining -= n;
+    }
+    return true;
+  }
+}
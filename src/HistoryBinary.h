@@ -0,0 +1,62 @@
+/*
+ * HistoryBinary
+ *     Support for the binary history file format, a compact alternative to
+ *     JSON that avoids text conversion when storing and loading histories.
+ *
+ * NOTES:
+ * o The layout of a file is:
+ *     File header:  "BPAH", version (1 byte), tier count (1 byte), 2 reserved bytes
+ *     For each tier:
+ *       Tier header: name length (1 byte), name, interval (4 bytes),
+ *                    record count (4 bytes), record size (2 bytes), CRC32
+ *       Blocks:      Up to BlockSize bytes of fixed-size records, then a CRC32
+ *                    of those bytes. Every block but the last is full.
+ * o All of the header fields and CRCs are little-endian. The records are
+ *   produced by Serializable::toBinary() and their layout is up to the item.
+ * o The record size acts as a format check for the items. If an item's layout
+ *   changes, so should its binarySize(), and files written with the old
+ *   layout will be rejected rather than misread.
+ *
+ */
+
+#ifndef HistoryBinary_h
+#define HistoryBinary_h
+
+#include <Arduino.h>
+
+namespace HistoryBinary {
+  constexpr uint8_t Version = 1;
+  constexpr size_t MaxNameSize = 32;    // Including the terminator
+  constexpr size_t BlockSize = 256;     // Largest run of records covered by a single CRC
+
+  struct TierHeader {
+    char name[MaxNameSize];
+    uint32_t interval;
+    uint32_t count;
+    uint16_t recordSize;
+  };
+
+  inline size_t recordsPerBlock(uint16_t recordSize) {
+    return (recordSize == 0 || recordSize > BlockSize) ? 0 : BlockSize / recordSize;
+  }
+
+  uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+  bool writeFileHeader(Print& out, uint8_t nTiers);
+  bool readFileHeader(Stream& in, uint8_t& nTiers);
+
+  bool writeTierHeader(Print& out, const TierHeader& header);
+  bool readTierHeader(Stream& in, TierHeader& header);
+
+  // Write nBytes of records followed by their CRC
+  bool writeBlock(Print& out, const uint8_t* records, size_t nBytes);
+
+  // Read nBytes of records and verify their CRC. Returns false if the data
+  // is short or the CRC doesn't match.
+  bool readBlock(Stream& in, uint8_t* records, size_t nBytes);
+
+  // Read past the blocks of a tier whose header has just been read
+  bool skipTier(Stream& in, const TierHeader& header);
+}
+
+#endif  // HistoryBinary_h
@@ -6,15 +6,41 @@
  * NOTES:
  * o The type you specify as a template parameter to HistoryBuffer must
  *   implement internalize() and externalize() methods.
- * o When using the HistoryBuffer template class, you specify (statically) the
- *   max number of elements and their type. These elements are allocated as
- *   part of the HistoryBuffer object (not separately in the heap).
+ * o When using the HistoryBuffer template class, you specify the type of the
+ *   elements and, optionally, a compile-time capacity. With a capacity, the
+ *   elements are allocated as part of the HistoryBuffer object (not separately
+ *   in the heap) and the nElements field of the descriptor is ignored. Without
+ *   one, the size comes from the descriptor and storage is either allocated on
+ *   the heap or provided by the caller.
  * o You can add elements to the history up to the size limit, and once
  *   that limit is reached, adding a new hisotry element will cause the
  *   oldest to be removed.
  * o Timestamps: If your data includes timestamps, they should be in 
  *   "wall clock" time rather than millis() since that gets reset on
  *   every boot. It is usually best to use times in GMT
+ * o Loading from a Stream or file is done one item at a time, so the size
+ *   of the history file is not limited by available RAM. Each item's JSON
+ *   representation must fit in MaxItemDocSize bytes.
+ * o Histories can also be stored in a compact binary format (see HistoryBinary.h)
+ *   using storeBinary() and loadBinary(), provided the item type implements the
+ *   binary functions of Serializable. JSON remains available for export, and
+ *   convertToBinary()/convertToJson() translate a file from one form to the other.
+ * o HistoryBufferBase is a type-erased interface for code that handles buffers
+ *   of different item types. Its store and load functions make one virtual call
+ *   per operation (storeItems(), loadItems(), ...) and the derived class, which
+ *   knows the item type, handles the items with direct calls. Code that knows
+ *   the concrete HistoryBuffer type can also use begin()/end() or asSpans().
+ * o Running statistics (min/max/mean/variance) of a value in the items can be
+ *   kept up to date as items are pushed by attaching a HistoryStats object
+ *   with addStats(). See HistoryStats.h.
+ * o A client that polls for history can fetch just the items added since its
+ *   last request with storeFrom(cursor) or storeSince(timestamp). If it has
+ *   fallen so far behind that items it never saw have been overwritten, it is
+ *   told to resync and is sent the whole buffer.
+ * o When several consumers store the same buffer between changes, a
+ *   HistoryOutputCache lets all but the first replay the bytes that were
+ *   produced rather than serialize the items again. etag() identifies the
+ *   contents for HTTP caching. See HistoryOutputCache.h.
  *
  */
 
@@ -23,6 +49,7 @@
 
 //--------------- Begin:  Includes ---------------------------------------------
 //                                  Core Libraries
+#include <algorithm>
 //                                  Third Party Libraries
 #include <ArduinoLog.h>
 #include <ArduinoJson.h>
@@ -30,6 +57,13 @@
 #include <ESP_FS.h>
 //                                  Local Includes
 #include "BPACircularBuffer.h"
+#include "BufferedWriteStream.h"
+#include "HistoryAggregator.h"
+#include "HistoryBinary.h"
+#include "HistoryOutputCache.h"
+#include "HistoryStats.h"
+#include "JsonStreamReader.h"
+#include "JsonWriter.h"
 #include "Serializable.h"
 //--------------- End:    Includes ---------------------------------------------
 
@@ -43,7 +77,7 @@ using HBDescriptor = struct {
 class HistoryBufferBase {
 public:
   time_t _interval = 0;
-  const char* _name;
+  const char* _name = nullptr;
 
   // ----- Abstract Member Functions
 
@@ -61,23 +95,25 @@ public:
   virtual bool push(const Serializable& item) = 0;
   virtual bool conditionalPush(const Serializable& item) = 0;
 
+  // The size of an item's binary representation. 0 if there is none.
+  virtual size_t itemBinarySize() const = 0;
+
+  // Add an item from its binary representation
+  virtual void pushBinary(const uint8_t* record) = 0;
+
 
   // ----- Concrete Member Functions
 
   bool store(Stream& writeStream) const {
     writePreamble(writeStream);
 
-    // Write the items
-    size_t nElements = size();
-    for (size_t i = 0; i < nElements; i++) {
-      if (i) writeStream.print(',');
-      const Serializable& item = peekAt(i);
-      item.externalize(writeStream);
-    }
+    // Write the items. The writer separates them with commas.
+    JsonWriter writer(writeStream);
+    storeItems(writer);
 
     writePostscript(writeStream);
 
-    return true;
+    return !writeStream.getWriteError();
   }
 
   bool store(const String& historyFilePath) const {
@@ -88,7 +124,10 @@ public:
       return false;
     }
 
-    bool success = store(historyFile);
+    StaticBufferedWriteStream<> bufferedFile(historyFile);
+    bool success = store(bufferedFile);
+    bufferedFile.flush();
+    success = success && !bufferedFile.getWriteError();
     historyFile.close();
 
     if (success) Log.verbose("HistoryBuffer written written to file: %s", historyFilePath.c_str());
@@ -96,49 +135,64 @@ public:
     return success;
   }
 
+  // Like store(Stream&), but if the buffer hasn't changed since cache was last
+  // filled with its JSON, replay the cached bytes instead
+  bool store(Stream& writeStream, HistoryOutputCache& cache) const {
+    return storeCached(writeStream, cache, HistoryOutputCache::Format::Json);
+  }
+
   bool load(const JsonObjectConst& historyElement) {
     clear();  // Start from scratch...
 
     JsonArrayConst historyArray = historyElement[F("history")];
 
-    uint32_t nLoaded = 0;
     for (JsonObjectConst jsonItem : historyArray) {
       push(jsonItem);
-      nLoaded++;
-    }
-    if (nLoaded) {
-      _lastTimeStamp = last().timestamp;
     }
+    loadComplete();
 
     return true;
   }
 
   bool load(Stream& readStream) {
-    DynamicJsonDocument doc(MaxHistoryFileSize);
-    auto error = deserializeJson(doc, readStream);
-    if (error) {
-      Log.warning(F("HistoryBuffer::load: Parse error: %s"), error.c_str());
+    JsonStreamReader reader(readStream);
+    return load(reader);
+  }
+
+  // Load from the history object that is the next value in reader. Items
+  // are deserialized and pushed one at a time using a small document.
+  bool load(JsonStreamReader& reader) {
+    clear();  // Start from scratch...
+
+    DynamicJsonDocument itemDoc(MaxItemDocSize);
+    char key[JsonStreamReader::MaxKeySize];
+
+    if (reader.beginObject()) {
+      while (reader.nextMember(key, sizeof(key))) {
+        if (strcmp(key, "history") != 0) {
+          reader.skipValue();
+          continue;
+        }
+        if (!reader.beginArray()) break;
+        loadItems(reader, itemDoc);
+      }
+    }
+
+    if (reader.failed()) {
+      Log.warning(F("HistoryBuffer::load: Unable to parse history"));
       return false;
     }
 
-    const JsonObjectConst root = doc.as<JsonObjectConst>();
-    return load(root);
+    loadComplete();
+    return true;
   }
 
   bool load(const String& historyFilePath) {
-    size_t size = 0;
     File historyFile = ESP_FS::open(historyFilePath, "r");
 
     if (!historyFile) {
       Log.error(F("Failed to open history file for read: %s"), historyFilePath.c_str());
       return false;
-    } else {
-      size = historyFile.size();
-      if (size > MaxHistoryFileSize) {
-        Log.warning(F("HistoryBuffer file is too big: %d"), size);
-        historyFile.close();
-        return false;
-      }    
     }
 
     bool success = load(historyFile);
@@ -150,12 +204,270 @@ public:
     return success;
   }
 
+  bool storeBinary(Stream& writeStream) const {
+    return HistoryBinary::writeFileHeader(writeStream, 1) && storeBinaryTier(writeStream);
+  }
+
+  // The binary counterpart of store(Stream&, HistoryOutputCache&)
+  bool storeBinary(Stream& writeStream, HistoryOutputCache& cache) const {
+    return storeCached(writeStream, cache, HistoryOutputCache::Format::Binary);
+  }
+
+  bool storeBinary(const String& historyFilePath) const {
+    File historyFile = ESP_FS::open(historyFilePath, "w");
+
+    if (!historyFile) {
+      Log.error(F("Failed to open history file for writing: %s"), historyFilePath.c_str());
+      return false;
+    }
+
+    StaticBufferedWriteStream<> bufferedFile(historyFile);
+    bool success = storeBinary(bufferedFile);
+    bufferedFile.flush();
+    success = success && !bufferedFile.getWriteError();
+    historyFile.close();
+
+    if (success) Log.verbose("HistoryBuffer written to binary file: %s", historyFilePath.c_str());
+    else Log.warning("Error saving binary history to %s", historyFilePath.c_str());
+    return success;
+  }
+
+  // Loads the first tier in the stream, regardless of its name
+  bool loadBinary(Stream& readStream) {
+    uint8_t nTiers;
+    HistoryBinary::TierHeader header;
+
+    clear();
+    if (!HistoryBinary::readFileHeader(readStream, nTiers)) return false;
+    if (nTiers == 0) return true;
+    if (!HistoryBinary::readTierHeader(readStream, header)) return false;
+    return loadBinaryTier(readStream, header);
+  }
+
+  bool loadBinary(const String& historyFilePath) {
+    File historyFile = ESP_FS::open(historyFilePath, "r");
+
+    if (!historyFile) {
+      Log.error(F("Failed to open history file for read: %s"), historyFilePath.c_str());
+      return false;
+    }
+
+    bool success = loadBinary(historyFile);
+    historyFile.close();
+
+    if (success) Log.verbose("HistoryBuffer data loaded from binary file");
+    else Log.warning("Error loading binary history from %s", historyFilePath.c_str());
+
+    return success;
+  }
+
+  // Write this buffer as one tier: a tier header followed by its blocks
+  bool storeBinaryTier(Stream& writeStream) const {
+    size_t recordSize = itemBinarySize();
+    size_t perBlock = HistoryBinary::recordsPerBlock(recordSize);
+    if (perBlock == 0) {
+      Log.error(F("HistoryBuffer: Items of %s can't be stored in binary form"), _name);
+      return false;
+    }
+
+    HistoryBinary::TierHeader header;
+    strncpy(header.name, _name ? _name : "", HistoryBinary::MaxNameSize - 1);
+    header.name[HistoryBinary::MaxNameSize - 1] = '\0';
+    header.interval = _interval;
+    header.count = size();
+    header.recordSize = recordSize;
+    if (!HistoryBinary::writeTierHeader(writeStream, header)) return false;
+
+    uint8_t block[HistoryBinary::BlockSize];
+    for (size_t i = 0; i < header.count; ) {
+      size_t n = std::min(perBlock, header.count - i);
+      storeRecords(i, n, block);
+      if (!HistoryBinary::writeBlock(writeStream, block, n * recordSize)) return false;
+      i += n;
+    }
+
+    return !writeStream.getWriteError();
+  }
+
+  // Load the blocks of a tier whose header has just been read. The whole tier
+  // is consumed even if some of it can't be used. If a block is corrupt, the
+  // items that precede it are kept and the rest are dropped.
+  bool loadBinaryTier(Stream& readStream, const HistoryBinary::TierHeader& header) {
+    clear();
+
+    size_t recordSize = itemBinarySize();
+    if (header.recordSize != recordSize) {
+      Log.warning(F("HistoryBuffer: Record size for %s is %d, expected %d"), header.name, header.recordSize, recordSize);
+      HistoryBinary::skipTier(readStream, header);
+      return false;
+    }
+
+    size_t perBlock = HistoryBinary::recordsPerBlock(recordSize);
+    if (perBlock == 0) {
+      Log.warning(F("HistoryBuffer: Items of %s can't be loaded from binary form"), header.name);
+      HistoryBinary::skipTier(readStream, header);
+      return false;
+    }
+
+    uint8_t block[HistoryBinary::BlockSize];
+    bool intact = true;
+    for (size_t i = 0; i < header.count; ) {
+      size_t n = std::min(perBlock, header.count - i);
+      if (!HistoryBinary::readBlock(readStream, block, n * recordSize)) {
+        if (intact) Log.warning(F("HistoryBuffer: Corrupt block in %s"), header.name);
+        intact = false;
+      } else if (intact) {
+        loadRecords(block, n);
+      }
+      i += n;
+    }
+
+    loadComplete();
+    return intact;
+  }
+
+  // Translate a history file from one format to the other. Since the buffer
+  // is used to hold the data along the way, its contents are replaced.
+  bool convertToBinary(const String& jsonPath, const String& binaryPath) {
+    return load(jsonPath) && storeBinary(binaryPath);
+  }
+
+  bool convertToJson(const String& binaryPath, const String& jsonPath) {
+    return loadBinary(binaryPath) && store(jsonPath);
+  }
+
   void getTimeRange(time_t& start, time_t& end) const {
     start = first().timestamp;
     end = last().timestamp;
   }
 
+  // ----- Incremental export. A client that polls for history can ask for just
+  // ----- the items it doesn't already have. Each response is in the same form
+  // ----- as store(), with two extra members:
+  // -----   { "cursor": 1234, "resync": false, "history": [ ... ]}
+  // ----- cursor is what to pass to storeFrom() next time. If resync is true the
+  // ----- client has missed items (they were overwritten, or the buffer was
+  // ----- cleared or reloaded) and the response holds the whole buffer instead,
+  // ----- which should replace what the client has.
+
+  // Identifies the point just after the newest item. Unlike an index, it stays
+  // valid as items are pushed and the oldest ones are overwritten.
+  uint32_t cursor() const { return _nAdded + _nClears; }
+
+  // Write the items added since cursor was obtained from cursor() or from an
+  // earlier response. A cursor of 0 always gets the whole buffer.
+  bool storeFrom(uint32_t since, Stream& writeStream) const {
+    size_t nItems = size();
+    uint32_t behind = cursor() - since;   // Also catches a cursor from the future
+    bool resync = (since == 0 || behind > nItems);
+    size_t index = resync ? 0 : nItems - behind;
+    return storeRange(index, resync, writeStream);
+  }
+
+  // Write the items whose timestamps are later than t. The client is told to
+  // resync if items that might have been later than t are gone.
+  bool storeSince(time_t t, Stream& writeStream) const {
+    size_t nItems = size();
+    size_t index = indexAfter(t);
+    bool dropped = (cursor() - _clearCursor) > nItems;
+    bool resync = (index == 0 && dropped);
+    return storeRange(index, resync, writeStream);
+  }
+
+  // ----- Incremental persistence (see HistoryBuffers::persist)
+
+  // The number of items added since the buffer was last persisted that are
+  // still in the buffer
+  size_t unpersistedCount() const { return std::min(_nUnpersisted, size()); }
+
+  // True if the buffer has changed in a way that can't be captured by
+  // appending its newest items, e.g. it has been cleared or never persisted
+  bool needsSnapshot() const { return _needsSnapshot; }
+
+  // Record that the contents of the buffer match what has been persisted
+  void markPersisted() { _nUnpersisted = 0; _needsSnapshot = false; }
+
+  // Changes whenever the contents of the buffer change. Comparing it to an
+  // earlier value tells whether the buffer has changed in the meantime.
+  uint32_t generation() const { return _generation; }
+
+  // An ETag-like value for the current contents, e.g. so an HTTP handler can
+  // answer 304 Not Modified. It changes along with generation(). Since that
+  // starts over on every boot, a random per-boot value and the newest timestamp
+  // are mixed in so that a value from before a restart won't match.
+  uint32_t etag() const {
+    static const uint32_t bootNonce = random(0x7fffffff);   // The ESP cores use the hardware RNG
+    uint32_t values[] = {
+        bootNonce, _generation, static_cast<uint32_t>(size()), static_cast<uint32_t>(newestTimestamp()) };
+    uint32_t hash = 2166136261UL;   // FNV-1a
+    for (uint32_t v : values) {
+      for (int i = 0; i < 4; i++, v >>= 8) hash = (hash ^ (v & 0xff)) * 16777619UL;
+    }
+    return hash;
+  }
+
+  // The number of items ever added to the buffer. It isn't reset by clear(),
+  // so the item at index i can be identified across pushes by the sequence
+  // number itemsAdded() - size() + i.
+  uint32_t itemsAdded() const { return _nAdded; }
+
+  // Called once items have been loaded or replayed from persistent storage
+  void loadComplete() {
+    _lastTimeStamp = newestTimestamp();
+    markPersisted();
+  }
+
 protected:
+  // ----- Per item work done on behalf of the functions above. A derived class
+  // ----- that knows its item type overrides these so that there is a single
+  // ----- virtual call per operation rather than one per item.
+
+  // Externalize every item
+  virtual void storeItems(JsonWriter& writer) const {
+    size_t nElements = size();
+    for (size_t i = 0; i < nElements; i++) peekAt(i).externalizeTo(writer);
+  }
+
+  // Externalize n items starting at index
+  virtual void storeItems(JsonWriter& writer, size_t index, size_t n) const {
+    for (size_t i = 0; i < n; i++) peekAt(index + i).externalizeTo(writer);
+  }
+
+  // The index of the first item whose timestamp is later than t, or size() if
+  // there is none. Items are assumed to be in timestamp order.
+  virtual size_t indexAfter(time_t t) const {
+    size_t low = 0, high = size();
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (static_cast<time_t>(peekAt(mid).timestamp) <= t) low = mid + 1;
+      else high = mid;
+    }
+    return low;
+  }
+
+  // The timestamp of the newest item, or 0 if there are none. An item type may
+  // declare its own timestamp, hiding Serializable's, so a derived class that
+  // knows the item type reads it from there.
+  virtual time_t newestTimestamp() const { return size() ? last().timestamp : 0; }
+
+  // Push each item of the array reader is positioned in, using doc to hold one
+  // item at a time
+  virtual void loadItems(JsonStreamReader& reader, JsonDocument& doc) {
+    while (reader.nextElement() && reader.read(doc)) push(doc.as<JsonObjectConst>());
+  }
+
+  // Write the binary form of n items starting at index to dest
+  virtual void storeRecords(size_t index, size_t n, uint8_t* dest) const {
+    size_t recordSize = itemBinarySize();
+    for (size_t i = 0; i < n; i++) peekAt(index + i).toBinary(dest + i * recordSize);
+  }
+
+  // Push n items from their binary form
+  virtual void loadRecords(const uint8_t* records, size_t n) {
+    size_t recordSize = itemBinarySize();
+    for (size_t i = 0; i < n; i++) pushBinary(records + i * recordSize);
+  }
+
   void writePreamble(Stream& writeStream) const {
     writeStream.print("{ \"history\": [");
   }
@@ -165,15 +477,53 @@ protected:
     writeStream.flush();
   }
 
+  bool storeCached(Stream& writeStream, HistoryOutputCache& cache, HistoryOutputCache::Format format) const {
+    if (cache.holds(this, _generation, format)) return cache.replay(writeStream);
+
+    HistoryOutputCache::Recorder recorder(cache, writeStream);
+    bool success = (format == HistoryOutputCache::Format::Json) ? store(recorder) : storeBinary(recorder);
+    recorder.finish(this, _generation, format, success);
+    return success;
+  }
+
+  bool storeRange(size_t index, bool resync, Stream& writeStream) const {
+    writeStream.print("{ \"cursor\": ");
+    writeStream.print(cursor());
+    writeStream.print(resync ? ", \"resync\": true" : ", \"resync\": false");
+    writeStream.print(", \"history\": [");
+
+    JsonWriter writer(writeStream);
+    storeItems(writer, index, size() - index);
+
+    writePostscript(writeStream);
+    return !writeStream.getWriteError();
+  }
+
+  void noteAdded() { _nUnpersisted++; _nAdded++; _generation++; }
+
+  // A clear counts as a step of the cursor so that a client that was up to
+  // date beforehand is told to resync
+  void noteCleared() {
+    _nUnpersisted = 0; _needsSnapshot = true; _generation++;
+    _nClears++;
+    _clearCursor = cursor();
+  }
+
+  static constexpr size_t MaxItemDocSize = 512;
+
   time_t _lastTimeStamp = 0;
 
 private:
-  static constexpr size_t MaxHistoryFileSize = 12000;
-
+  size_t _nUnpersisted = 0;
+  bool _needsSnapshot = true;
+  uint32_t _generation = 0;
+  uint32_t _nAdded = 0;
+  uint32_t _nClears = 1;        // A new buffer counts as cleared, so cursor() is never 0
+  uint32_t _clearCursor = 1;    // cursor() just after the last clear
 };
 
 
-template<typename ItemType>
+template<typename ItemType, size_t Capacity = 0>
 class HistoryBuffer  : public HistoryBufferBase {
 
 public:
@@ -190,9 +540,19 @@ public:
     init(desc, space);
   }
 
+  HistoryBuffer(const HBDescriptor& desc, BPAAllocator& allocator) {
+    init(desc, allocator);
+  }
+
   void init(const HBDescriptor& desc, ItemType* space = nullptr) {
-    if (space) _historyItems.init(space, desc.nElements);
-    else _historyItems.init(desc.nElements);
+    initStorage(desc, space, BPAAllocator::heap(), std::integral_constant<bool, Capacity == 0>());
+    _name = desc.name;
+    _interval = desc.interval;
+  }
+
+  // Allocate the storage from allocator (e.g. an arena shared by several buffers)
+  void init(const HBDescriptor& desc, BPAAllocator& allocator) {
+    initStorage(desc, nullptr, allocator, std::integral_constant<bool, Capacity == 0>());
     _name = desc.name;
     _interval = desc.interval;
   }
@@ -204,16 +564,119 @@ public:
  *
  *----------------------------------------------------------------------------*/
 
+  // If there is an aggregator, every item is accumulated and the aggregate
+  // is pushed when the interval closes. Otherwise only the item that closes
+  // the interval is pushed.
   inline bool conditionalPush(const ItemType& item) {
+    if (_aggregator) _aggregator->accumulate(item);
     if (item.timestamp - _lastTimeStamp >= _interval) {
-      _historyItems.push(item);
+      if (_aggregator) {
+        ItemType aggregate(item);
+        _aggregator->emit(aggregate);
+        _aggregator->reset();
+        push(std::move(aggregate));
+      } else {
+        push(item);
+      }
       _lastTimeStamp = item.timestamp;
       return true;
     }
     return false;
   }
 
-  inline bool push(const ItemType& item) { return _historyItems.push(item);  }
+  // Summarize every item offered to conditionalPush() during an interval
+  // rather than sampling one. The aggregator is owned by the caller and
+  // may be removed by passing nullptr.
+  void setAggregator(HistoryAggregator<ItemType>* aggregator) {
+    _aggregator = aggregator;
+    if (_aggregator) _aggregator->reset();
+  }
+
+  // A buffer with no storage (its allocation failed) ignores additions
+  inline bool push(const ItemType& item) {
+    if (!capacity()) return false;
+    beginAdd();
+    bool added = _historyItems.push(item);
+    endAdd();
+    return added;
+  }
+
+  inline bool push(ItemType&& item) {
+    if (!capacity()) return false;
+    beginAdd();
+    bool added = _historyItems.push(std::move(item));
+    endAdd();
+    return added;
+  }
+
+  // Internalize jsonItem directly into the slot for the next item rather than
+  // building a temporary and copying it in
+  bool emplaceFromJson(JsonObjectConst jsonItem) {
+    if (!capacity()) return false;
+    beginAdd();
+    bool added = _historyItems.emplace();
+    _historyItems.back().ItemType::internalize(jsonItem);
+    endAdd();
+    return added;
+  }
+
+  size_t capacity() const { return _historyItems.capacity(); }
+
+  using const_iterator = typename BPACircularBuffer<ItemType, Capacity>::const_iterator;
+
+  // Walk the items, oldest first, without a virtual peekAt() call per item
+  const_iterator begin() const { return _historyItems.begin(); }
+  const_iterator end() const { return _historyItems.end(); }
+
+  // The items, oldest first, as at most two contiguous segments
+  bpa::RingSpans<const ItemType> asSpans() const { return _historyItems.asSpans(); }
+
+  // n items starting at index, as at most two contiguous segments
+  bpa::RingSpans<const ItemType> asSpans(size_t index, size_t n) const {
+    return _historyItems.asSpans(index, n);
+  }
+
+  // Keep stats up to date as items are added. stats is owned by the caller and
+  // must remain attached for the life of the buffer or until removeStats().
+  void addStats(HistoryStats<ItemType>& stats) {
+    stats.attach(_historyItems.capacity());
+    stats._next = _stats;
+    _stats = &stats;
+
+    size_t nItems = size();
+    for (size_t i = nItems - std::min(nItems, stats.window()); i < nItems; i++) {
+      stats.beginAdd(nullptr);
+      stats.endAdd(peekAt(i));
+    }
+  }
+
+  void removeStats(HistoryStats<ItemType>& stats) {
+    for (HistoryStats<ItemType>** link = &_stats; *link; link = &(*link)->_next) {
+      if (*link == &stats) { *link = stats._next; stats._next = nullptr; return; }
+    }
+  }
+
+  // ----- Time based queries. These rely on items having been pushed in
+  // ----- timestamp order and use a binary search rather than a scan.
+
+  // The index of the first item whose timestamp is >= t, or size() if there is none
+  size_t lowerBound(time_t t) const {
+    return std::lower_bound(begin(), end(), t,
+        [](const ItemType& item, time_t key) { return static_cast<time_t>(item.timestamp) < key; }) - begin();
+  }
+
+  // The index of the first item whose timestamp is > t, or size() if there is none
+  size_t upperBound(time_t t) const {
+    return std::upper_bound(begin(), end(), t,
+        [](time_t key, const ItemType& item) { return key < static_cast<time_t>(item.timestamp); }) - begin();
+  }
+
+  // The items whose timestamps fall in [t0, t1], as at most two contiguous segments
+  bpa::RingSpans<const ItemType> rangeByTime(time_t t0, time_t t1) const {
+    size_t first = lowerBound(t0);
+    size_t last = upperBound(t1);
+    return asSpans(first, (last > first) ? last - first : 0);
+  }
 
 
 /*------------------------------------------------------------------------------
@@ -227,19 +690,20 @@ public:
   virtual const ItemType& last() const override { return _historyItems.peekAt(_historyItems.size()-1); }
   virtual const ItemType& peekAt(size_t index) const override { return _historyItems.peekAt(index); }
 
-  virtual void clear() override { _historyItems.clear(); }
-
-  virtual void push(JsonObjectConst jsonItem) override {
-    ItemType item;
-    item.internalize(jsonItem);
-    _historyItems.push(item);
+  virtual void clear() override {
+    _historyItems.clear();
+    if (_aggregator) _aggregator->reset();
+    for (HistoryStats<ItemType>* s = _stats; s; s = s->_next) s->reset();
+    noteCleared();
   }
 
+  virtual void push(JsonObjectConst jsonItem) override { emplaceFromJson(jsonItem); }
+
   virtual bool push(const Serializable& item) override {
     // We know based on the assert below that ItemType isa Serializable,
     // but it is up to the caller to ensure that this particulat Serializable
     // isa ItemType
-    return _historyItems.push(static_cast<const ItemType&>(item)); 
+    return push(static_cast<const ItemType&>(item)); 
   }
 
   virtual bool conditionalPush(const Serializable& item) override {
@@ -249,9 +713,78 @@ public:
     return conditionalPush(static_cast<const ItemType&>(item));
   }
 
+  virtual size_t itemBinarySize() const override { return ItemType().binarySize(); }
+
+  virtual void pushBinary(const uint8_t* record) override {
+    if (!capacity()) return;
+    beginAdd();
+    _historyItems.emplace();
+    _historyItems.back().ItemType::fromBinary(record);
+    endAdd();
+  }
+
+protected:
+  // The item type is known here, so the per item calls below are qualified.
+  // That makes them direct calls that the compiler can inline.
+
+  virtual void storeItems(JsonWriter& writer) const override { storeItems(writer, 0, size()); }
+
+  virtual void storeItems(JsonWriter& writer, size_t index, size_t n) const override {
+    auto item = _historyItems.begin() + index;
+    for (size_t i = 0; i < n; i++, ++item) item->ItemType::externalizeTo(writer);
+  }
+
+  virtual size_t indexAfter(time_t t) const override { return upperBound(t); }
+
+  virtual time_t newestTimestamp() const override { return size() ? last().timestamp : 0; }
+
+  virtual void loadItems(JsonStreamReader& reader, JsonDocument& doc) override {
+    while (reader.nextElement() && reader.read(doc)) emplaceFromJson(doc.as<JsonObjectConst>());
+  }
+
+  virtual void storeRecords(size_t index, size_t n, uint8_t* dest) const override {
+    size_t recordSize = ItemType().ItemType::binarySize();
+    auto item = _historyItems.begin() + index;
+    for (size_t i = 0; i < n; i++, ++item) item->ItemType::toBinary(dest + i * recordSize);
+  }
+
+  virtual void loadRecords(const uint8_t* records, size_t n) override {
+    size_t recordSize = ItemType().ItemType::binarySize();
+    for (size_t i = 0; i < n; i++) HistoryBuffer::pushBinary(records + i * recordSize);
+  }
+
 private:
   static_assert(std::is_base_of<Serializable, ItemType>::value, "HistoryBuffer Item must derive from Serializable");
-	BPACircularBuffer<ItemType> _historyItems;
+	BPACircularBuffer<ItemType, Capacity> _historyItems;
+  HistoryAggregator<ItemType>* _aggregator = nullptr;
+  HistoryStats<ItemType>* _stats = nullptr;
+
+  // Every addition is bracketed by these so that attached stats see the item
+  // that is leaving their window before it can be overwritten
+  void beginAdd() {
+    size_t nItems = size();
+    for (HistoryStats<ItemType>* s = _stats; s; s = s->_next) {
+      size_t window = s->window();
+      s->beginAdd((window && nItems >= window) ? &peekAt(nItems - window) : nullptr);
+    }
+  }
+
+  void endAdd() {
+    noteAdded();
+    for (HistoryStats<ItemType>* s = _stats; s; s = s->_next) s->endAdd(_historyItems.back());
+  }
+
+  void initStorage(
+      const HBDescriptor& desc, ItemType* space, BPAAllocator& allocator,
+      std::true_type /* runtime capacity */)
+  {
+    if (space) _historyItems.init(space, desc.nElements);
+    else if (!_historyItems.init(desc.nElements, allocator)) {
+      Log.error(F("HistoryBuffer: Unable to allocate %d items for %s"), desc.nElements, desc.name);
+    }
+  }
+
+  void initStorage(const HBDescriptor&, ItemType*, BPAAllocator&, std::false_type /* inline storage */) { }
   
 };
 
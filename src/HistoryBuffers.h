@@ -3,19 +3,50 @@
  *     Manage a collection of related HistoryBuffer objects
  *
  * CONSIDER:
- * o It can be very memory intensive to load from a single file
- *   that contains multiple HistoryBuffer serializations. To get
- *   around this we could either:
- *   a) Save each history buffer to a separate file and load from
- *      those files OR
- *   b) Use a filter document and load the same file N times using each
- *      buffer's name to get just the data in question.
- *   The former should, in theory, be faster, but from a developer
- *   perspective it's kind of a pain to have multiple files if you want
- *   to read back and preserve state.
  * o Think about adding a max size to the buffer descriptor to guide
  *   how much space to allocate.
  *
+ * NOTES:
+ * o The buffers can be initialized one at a time with describe(), in which
+ *   case each one gets its own storage, or all at once from an array of
+ *   descriptors with init(), in which case they share one contiguous block.
+ * o StaticHistoryBuffers owns that block as a member whose size is computed
+ *   at compile time from a constexpr descriptor array. Declared globally, the
+ *   whole multi-tier history is then accounted for at link time:
+ *     constexpr HBDescriptor Tiers[] = { {12, "hour", 300}, {24, "day", 3600} };
+ *     StaticHistoryBuffers<THPReadings, 2, totalHistoryElements(Tiers)> history;
+ *     ...
+ *     history.init(Tiers);
+ * o Loading is streamed, so memory use doesn't depend on the size of the
+ *   file. When only some of the buffers are needed (e.g. the "hour" buffer
+ *   for a display at boot), load(path, names) or loadOne(path, index) loads
+ *   just those. The data for the other buffers is skipped without parsing it.
+ * o Alternatively, each buffer can be kept in its own file, <base>.<name>.json
+ *   (or .bin), with storeSplit() and loadSplit(). storeSplit() only rewrites
+ *   the files of buffers that have changed. With a lazy loadSplit(), a buffer
+ *   isn't read until it is first accessed with operator[] or getMutable(), so
+ *   the first screen after boot only waits for the buffer it displays. Anything
+ *   that needs every buffer (store, persist, conditionalPushAll, ...) loads the
+ *   remaining ones first. A buffer whose file fails to load stays waiting: the
+ *   load is tried again on the next access, and storeSplit() leaves its file
+ *   alone, until a load succeeds or clearAll() is called.
+ * o beginStore()/stepStore()/finishStore() write the same file as store(), a
+ *   few items at a time, so that a large history doesn't block loop() for
+ *   long. Each step writes items until its time budget runs out. The items
+ *   to write are fixed by beginStore() using sequence numbers rather than
+ *   indices, so items may be pushed between steps. Items that are pushed
+ *   out of a buffer before they are written are skipped. beginLoad(),
+ *   stepLoad(), and finishLoad() do the same for load(), but nothing should
+ *   be pushed while a load is in progress. HistoryStoreAction and
+ *   HistoryLoadAction (HistoryActions.h) drive them from the ActionManager.
+ * o Instead of rewriting the whole history file each time, persist() appends
+ *   the items added since the last call to a journal (<path>.jnl). When the
+ *   journal grows too large, compactIfNeeded() folds it into a new snapshot
+ *   (<path>). loadPersisted() loads the snapshot and replays the journal.
+ *   Each snapshot carries an epoch number, and the journal records the epoch
+ *   of the snapshot it extends, so a journal left behind by an interrupted
+ *   compaction is never replayed twice.
+ *
  */
 
 #ifndef HistoryBuffers_h
@@ -24,6 +55,7 @@
 //--------------- Begin:  Includes ---------------------------------------------
 //                                  Core Libraries
 #include <array>
+#include <initializer_list>
 //                                  Third Party Libraries
 #include <ArduinoLog.h>
 #include <ArduinoJson.h>
@@ -34,6 +66,13 @@
 //--------------- End:    Includes ---------------------------------------------
 
 
+// The number of elements needed to hold every buffer described by descriptors
+template<size_t N>
+constexpr size_t totalHistoryElements(const HBDescriptor (&descriptors)[N], size_t i = 0) {
+  return (i == N) ? 0 : descriptors[i].nElements + totalHistoryElements(descriptors, i + 1);
+}
+
+
 template<typename BufferType, int Size>
 class HistoryBuffers {
 public:
@@ -46,27 +85,38 @@ public:
 
   HistoryBuffers() = default;
 
+  ~HistoryBuffers() {
+    abortStore();
+    abortLoad();
+  }
+
   void describe(const HBDescriptor& descriptor) {
     buffers[nBuffersDescribed++].init(descriptor);
   }
 
+  // Allocate the buffer's storage from allocator. Describing every buffer with
+  // the same arena keeps all of the history in one region of memory.
+  void describe(const HBDescriptor& descriptor, BPAAllocator& allocator) {
+    buffers[nBuffersDescribed++].init(descriptor, allocator);
+  }
+
+  // Initialize every buffer at once. Each buffer's storage is carved, in order,
+  // out of space, which must hold totalHistoryElements(descriptors) items.
+  void init(const HBDescriptor (&descriptors)[Size], BufferType* space) {
+    for (int i = 0; i < Size; i++) {
+      buffers[i].init(descriptors[i], space);
+      space += descriptors[i].nElements;
+    }
+    nBuffersDescribed = Size;
+  }
+
 /*------------------------------------------------------------------------------
  *
  * Internalize / Externalize HistoryBuffers
  *
  *----------------------------------------------------------------------------*/
 
-  bool store(Stream& writeStream) {
-    writeStream.print("{ ");
-    for (int i = 0; i < Size; i++) {
-      if (i) writeStream.print(", ");
-      writeStream.print('"'); writeStream.print(buffers[i]._name); writeStream.print("\":");
-      buffers[i].store(writeStream);
-    }
-    writeStream.print(" }");
-
-    return true;
-  }
+  bool store(Stream& writeStream) { return writeSnapshot(writeStream, 0); }
 
   bool store(const String& historyFilePath) {
     File historyFile = ESP_FS::open(historyFilePath, "w");
@@ -76,7 +126,10 @@ public:
       return false;
     }
 
-    bool success = store(historyFile);
+    StaticBufferedWriteStream<> bufferedFile(historyFile);
+    bool success = store(bufferedFile);
+    bufferedFile.flush();
+    success = success && !bufferedFile.getWriteError();
     historyFile.close();
 
     if (success) Log.verbose("HistoryBuffers written to file: %s", historyFilePath.c_str());
@@ -85,49 +138,450 @@ public:
     return success;
   }
 
-  bool load(Stream& readStream) {
-    DynamicJsonDocument doc(MaxHistoryFileSize);
+  // Buffers are loaded one at a time, as they are encountered in the stream,
+  // and each buffer is loaded an item at a time. Buffers that don't appear in
+  // the stream are left empty, and unrecognized names are skipped. If there is
+  // an error, the buffers that precede it will already have been loaded.
+  bool load(Stream& readStream) { return loadSelected(readStream, nullptr); }
+  bool load(const String& historyFilePath) { return loadSelected(historyFilePath, nullptr); }
+
+  // Load only the named buffers, e.g. load(path, {"hour"}). The data for the
+  // other buffers is stepped over without being parsed, and those buffers are
+  // left as they are.
+  bool load(Stream& readStream, std::initializer_list<const char*> names) {
+    bool selected[Size];
+    return loadSelected(readStream, select(names, selected));
+  }
+
+  bool load(const String& historyFilePath, std::initializer_list<const char*> names) {
+    bool selected[Size];
+    return loadSelected(historyFilePath, select(names, selected));
+  }
+
+  // Load only the buffer at index
+  bool loadOne(Stream& readStream, int index) {
+    bool selected[Size] = { false };
+    selected[index] = true;
+    return loadSelected(readStream, selected);
+  }
+
+  bool loadOne(const String& historyFilePath, int index) {
+    bool selected[Size] = { false };
+    selected[index] = true;
+    return loadSelected(historyFilePath, selected);
+  }
+
+  bool storeBinary(Stream& writeStream) {
+    loadPending();
+    if (!HistoryBinary::writeFileHeader(writeStream, Size)) return false;
+    for (int i = 0; i < Size; i++) {
+      if (!buffers[i].storeBinaryTier(writeStream)) return false;
+    }
+    return true;
+  }
+
+  bool storeBinary(const String& historyFilePath) {
+    File historyFile = ESP_FS::open(historyFilePath, "w");
 
-    auto error = deserializeJson(doc, readStream);
-    if (error) {
-      Log.warning(F("Failed to parse history stream: %s"), error.c_str());
+    if (!historyFile) {
+      Log.error(F("Failed to open history file for writing: %s"), historyFilePath.c_str());
       return false;
     }
 
-    JsonObjectConst obj;
-    for (int i = 0; i < Size; i++) {
-      obj = doc[buffers[i]._name];
-      buffers[i].load(obj);
+    StaticBufferedWriteStream<> bufferedFile(historyFile);
+    bool success = storeBinary(bufferedFile);
+    bufferedFile.flush();
+    success = success && !bufferedFile.getWriteError();
+    historyFile.close();
+
+    if (success) Log.verbose("HistoryBuffers written to binary file: %s", historyFilePath.c_str());
+    else Log.warning("Error saving binary history to %s", historyFilePath.c_str());
+
+    return success;
+  }
+
+  // Tiers are matched to buffers by name. Buffers that don't appear in the
+  // stream are left empty, and unrecognized tiers are skipped.
+  bool loadBinary(Stream& readStream) {
+    uint8_t nTiers;
+    if (!HistoryBinary::readFileHeader(readStream, nTiers)) return false;
+
+    clearAll();
+    _journalValid = false;
+    bool success = true;
+    for (uint8_t t = 0; t < nTiers; t++) {
+      HistoryBinary::TierHeader header;
+      if (!HistoryBinary::readTierHeader(readStream, header)) return false;
+      HistoryBuffer<BufferType>* buffer = find(header.name);
+      if (buffer) success = buffer->loadBinaryTier(readStream, header) && success;
+      else if (!HistoryBinary::skipTier(readStream, header)) return false;
     }
 
-    return true;
+    return success;
   }
 
-  bool load(const String& historyFilePath) {
-    size_t size = 0;
+  bool loadBinary(const String& historyFilePath) {
     File historyFile = ESP_FS::open(historyFilePath, "r");
 
     if (!historyFile) {
       Log.error(F("Failed to open history file for read: %s"), historyFilePath.c_str());
       return false;
-    } else {
-      size = historyFile.size();
-      if (size > MaxHistoryFileSize) {
-        Log.warning(F("HistoryBuffer file is too big: %d"), size);
-        historyFile.close();
-        return false;
-      }    
     }
 
-    bool success = load(historyFile);
+    bool success = loadBinary(historyFile);
     historyFile.close();
 
-    if (success) Log.verbose("HistoryBuffers loaded from %s", historyFilePath.c_str());
-    else Log.warning("Error loading history from %s", historyFilePath.c_str());
-    
+    if (success) Log.verbose("HistoryBuffers loaded from binary file %s", historyFilePath.c_str());
+    else Log.warning("Error loading binary history from %s", historyFilePath.c_str());
+
+    return success;
+  }
+
+  // Translate a history file from one format to the other. Since the buffers
+  // are used to hold the data along the way, their contents are replaced.
+  bool convertToBinary(const String& jsonPath, const String& binaryPath) {
+    return load(jsonPath) && storeBinary(binaryPath);
+  }
+
+  bool convertToJson(const String& binaryPath, const String& jsonPath) {
+    return loadBinary(binaryPath) && store(jsonPath);
+  }
+
+/*------------------------------------------------------------------------------
+ *
+ * Incremental store and load
+ *
+ *----------------------------------------------------------------------------*/
+
+  // Start writing the history to path. The data goes to <path>.tmp, which
+  // replaces path when finishStore() succeeds. A store that is already in
+  // progress is abandoned.
+  bool beginStore(const String& path) {
+    abortStore();
+    loadPending();
+
+    String tempPath = path + ".tmp";
+    File file = ESP_FS::open(tempPath, "w");
+    if (!file) {
+      Log.error(F("Failed to open history file for writing: %s"), tempPath.c_str());
+      return false;
+    }
+
+    _storeJob = new StoreJob(file, path);
+    for (int i = 0; i < Size; i++) {
+      _storeJob->end[i] = buffers[i].itemsAdded();
+      _storeJob->first[i] = _storeJob->end[i] - buffers[i].size();
+    }
+    _storeJob->out.print("{ ");
+    return true;
+  }
+
+  // Write items until budgetMicros have elapsed (at least one item is always
+  // written). Returns true while there is more to write.
+  bool stepStore(uint32_t budgetMicros) {
+    if (_storeJob == nullptr || _storeJob->done) return false;
+    StoreJob& job = *_storeJob;
+    Stream& out = job.out;
+    uint32_t start = micros();
+
+    while (job.tier < Size) {
+      HistoryBuffer<BufferType>& buffer = buffers[job.tier];
+      if (!job.inTier) {
+        if (job.tier) out.print(", ");
+        out.print('"'); out.print(buffer._name); out.print("\":{ \"history\": [");
+        job.inTier = true;
+        job.next = job.first[job.tier];
+        job.wroteItem = false;
+      }
+
+      // Skip anything that has been pushed out of the buffer in the meantime
+      uint32_t oldest = buffer.itemsAdded() - buffer.size();
+      if (static_cast<int32_t>(oldest - job.next) > 0) job.next = oldest;
+
+      if (static_cast<int32_t>(job.end[job.tier] - job.next) <= 0) {
+        out.println("]}");
+        job.inTier = false;
+        job.tier++;
+        continue;
+      }
+
+      if (job.wroteItem) out.write(',');
+      JsonWriter writer(out);
+      buffer.peekAt(job.next - oldest).externalizeTo(writer);
+      job.wroteItem = true;
+      job.next++;
+      if (micros() - start >= budgetMicros) return true;
+    }
+
+    out.print(" }");
+    job.done = true;
+    return false;
+  }
+
+  // Complete the store begun by beginStore(). If it wasn't stepped to the
+  // end, or there was a write error, path is left as it was.
+  bool finishStore() {
+    if (_storeJob == nullptr) return false;
+    StoreJob& job = *_storeJob;
+    job.out.flush();
+    bool success = job.done && !job.out.getWriteError();
+    job.file.close();
+
+    String tempPath = job.path + ".tmp";
+    if (success) {
+      ESP_FS::remove(job.path);
+      success = ESP_FS::rename(tempPath.c_str(), job.path.c_str());
+    } else {
+      ESP_FS::remove(tempPath);
+    }
+
+    if (success) Log.verbose("HistoryBuffers written to file: %s", job.path.c_str());
+    else Log.warning("Error saving history to %s", job.path.c_str());
+
+    delete _storeJob;
+    _storeJob = nullptr;
+    return success;
+  }
+
+  // Start loading the history from path. Every buffer is cleared.
+  bool beginLoad(const String& path) {
+    abortLoad();
+
+    File file = ESP_FS::open(path, "r");
+    if (!file) {
+      Log.error(F("Failed to open history file for read: %s"), path.c_str());
+      return false;
+    }
+
+    clearAll();
+    _journalEpoch = 0;
+    _journalValid = false;
+    _loadJob = new LoadJob(file);
+    if (!_loadJob->reader.beginObject()) {
+      Log.warning(F("Failed to parse history file %s"), path.c_str());
+      abortLoad();
+      return false;
+    }
+    return true;
+  }
+
+  // Load items until budgetMicros have elapsed (at least one item is always
+  // loaded). Returns true while there is more to load.
+  bool stepLoad(uint32_t budgetMicros) {
+    if (_loadJob == nullptr || _loadJob->done) return false;
+    LoadJob& job = *_loadJob;
+    JsonStreamReader& reader = job.reader;
+    char key[JsonStreamReader::MaxKeySize];
+    uint32_t start = micros();
+
+    while (!reader.failed()) {
+      if (job.buffer == nullptr) {
+        // Between buffers
+        if (!reader.nextMember(key, sizeof(key))) {
+          job.done = !reader.failed();
+          return false;
+        }
+        job.buffer = find(key);
+        if (job.buffer) {
+          reader.beginObject();
+          job.inArray = false;
+        } else if (strcmp(key, EpochKey) == 0) {
+          readEpoch(reader, _journalEpoch);
+        } else {
+          reader.skipValue();
+        }
+        continue;
+      }
+
+      if (!job.inArray) {
+        // Within a buffer's object, looking for its history array
+        if (!reader.nextMember(key, sizeof(key))) {
+          job.buffer->loadComplete();
+          job.buffer = nullptr;
+        } else if (strcmp(key, "history") == 0) {
+          job.inArray = reader.beginArray();
+        } else {
+          reader.skipValue();
+        }
+        continue;
+      }
+
+      if (!reader.nextElement()) {
+        job.inArray = false;
+        continue;
+      }
+      JsonDocument& itemDoc = job.itemDoc;
+      if (!reader.read(itemDoc)) break;
+      job.buffer->emplaceFromJson(itemDoc.as<JsonObjectConst>());
+      if (micros() - start >= budgetMicros) return true;
+    }
+
+    return false;
+  }
+
+  // Complete the load begun by beginLoad(). Returns false if it wasn't
+  // stepped to the end or the file couldn't be parsed. The buffers that
+  // precede an error will already have been loaded.
+  bool finishLoad() {
+    if (_loadJob == nullptr) return false;
+    bool success = _loadJob->done;
+    if (!success) Log.warning(F("Failed to load history stream"));
+    abortLoad();
+    return success;
+  }
+
+/*------------------------------------------------------------------------------
+ *
+ * One file per buffer
+ *
+ *----------------------------------------------------------------------------*/
+
+  // Store each buffer that has changed since it was last stored to, or loaded
+  // from, its file. Buffers that haven't been loaded (yet, or successfully)
+  // are skipped.
+  bool storeSplit(const String& basePath, bool binary = false) {
+    if (basePath != _splitBase || binary != _splitBinary) {
+      loadPending();
+      for (int i = 0; i < Size; i++) _splitCurrent[i] = false;
+      _splitBase = basePath;
+      _splitBinary = binary;
+    }
+
+    bool success = true;
+    for (int i = 0; i < Size; i++) {
+      if (_pending[i]) continue;
+      if (_splitCurrent[i] && buffers[i].generation() == _splitGeneration[i]) continue;
+      String path = splitPath(i);
+      bool stored = binary ? buffers[i].storeBinary(path) : buffers[i].store(path);
+      if (stored) noteSplitCurrent(i);
+      success = success && stored;
+    }
+    return success;
+  }
+
+  // Load every buffer from its own file. If lazy, each buffer is loaded the
+  // first time it is accessed instead. A missing file leaves its buffer empty.
+  bool loadSplit(const String& basePath, bool lazy = true, bool binary = false) {
+    _splitBase = basePath;
+    _splitBinary = binary;
+    _journalValid = false;
+    for (int i = 0; i < Size; i++) {
+      _splitCurrent[i] = false;
+      _pending[i] = true;
+    }
+    return lazy ? true : loadPending();
+  }
+
+/*------------------------------------------------------------------------------
+ *
+ * Incremental persistence using a snapshot and a journal
+ *
+ *----------------------------------------------------------------------------*/
+
+  // Append the items added since the last persist to the journal. If the
+  // history has changed in a way the journal can't capture (e.g. a buffer
+  // was cleared), or there is no snapshot yet, a new snapshot is written instead.
+  bool persist(const String& snapshotPath) {
+    loadPending();
+    if (!_journalValid) return compact(snapshotPath);
+    for (int i = 0; i < Size; i++) {
+      if (buffers[i].needsSnapshot()) return compact(snapshotPath);
+    }
+
+    String path = journalPath(snapshotPath);
+    bool newJournal = !ESP_FS::exists(path);
+    File journal = ESP_FS::open(path, "a");
+    if (!journal) {
+      Log.error(F("Failed to open history journal for writing: %s"), path.c_str());
+      return false;
+    }
+
+    // Each journal entry is a line of the form {"<buffer name>":<item>}
+    StaticBufferedWriteStream<> out(journal);
+    if (newJournal) {
+      out.print("{\""); out.print(EpochKey); out.print("\":"); out.print(_journalEpoch); out.print("}\n");
+    }
+    for (int i = 0; i < Size; i++) {
+      const HistoryBuffer<BufferType>& buffer = buffers[i];
+      size_t nItems = buffer.size();
+      for (size_t j = nItems - buffer.unpersistedCount(); j < nItems; j++) {
+        JsonWriter writer(out);
+        writer.beginObject();
+        writer.key(buffer._name);
+        buffer.peekAt(j).externalizeTo(writer);
+        writer.endObject();
+        out.print('\n');
+      }
+    }
+    out.flush();
+    bool success = !out.getWriteError();
+    journal.close();
+
+    if (success) markAllPersisted();
+    else Log.warning("Error appending to history journal %s", path.c_str());
     return success;
   }
 
+  // Fold the journal into a new snapshot if it has grown beyond maxJournalSize
+  // bytes. Meant to be called periodically, e.g. from loop(). Returns false
+  // only if a compaction was needed and failed.
+  bool compactIfNeeded(const String& snapshotPath, size_t maxJournalSize = DefaultMaxJournalSize) {
+    File journal = ESP_FS::open(journalPath(snapshotPath), "r");
+    if (!journal) return true;
+    size_t journalSize = journal.size();
+    journal.close();
+    return (journalSize > maxJournalSize) ? compact(snapshotPath) : true;
+  }
+
+  // Write a complete snapshot of the history and discard the journal
+  bool compact(const String& snapshotPath) {
+    String tempPath = snapshotPath + ".tmp";
+    uint32_t epoch = _journalEpoch + 1;
+
+    File snapshot = ESP_FS::open(tempPath, "w");
+    if (!snapshot) {
+      Log.error(F("Failed to open history file for writing: %s"), tempPath.c_str());
+      return false;
+    }
+    StaticBufferedWriteStream<> out(snapshot);
+    bool success = writeSnapshot(out, epoch);
+    out.flush();
+    success = success && !out.getWriteError();
+    snapshot.close();
+    if (!success) {
+      Log.warning("Error saving history snapshot to %s", tempPath.c_str());
+      ESP_FS::remove(tempPath);
+      return false;
+    }
+
+    // From here on, a stale journal is recognized by its epoch
+    ESP_FS::remove(snapshotPath);
+    if (!ESP_FS::rename(tempPath.c_str(), snapshotPath.c_str())) {
+      Log.error(F("Failed to rename %s to %s"), tempPath.c_str(), snapshotPath.c_str());
+      return false;
+    }
+    ESP_FS::remove(journalPath(snapshotPath));
+
+    _journalEpoch = epoch;
+    _journalValid = true;
+    markAllPersisted();
+    Log.verbose("HistoryBuffers snapshot written to %s", snapshotPath.c_str());
+    return true;
+  }
+
+  // Load the snapshot written by compact() and replay the journal on top of it
+  bool loadPersisted(const String& snapshotPath) {
+    // Finish a compaction that was interrupted before the rename
+    String tempPath = snapshotPath + ".tmp";
+    if (!ESP_FS::exists(snapshotPath) && ESP_FS::exists(tempPath)) {
+      ESP_FS::rename(tempPath.c_str(), snapshotPath.c_str());
+    }
+
+    if (!load(snapshotPath)) return false;
+    _journalValid = replayJournal(journalPath(snapshotPath));
+    return true;
+  }
+
 /*------------------------------------------------------------------------------
  *
  * Access / Inspect / Modify elements of the HistoryBuffer
@@ -137,10 +591,14 @@ public:
   void clearAll() {
     for (int i = 0; i < Size; i++) {
       buffers[i].clear();
+      _pending[i] = false;
     }
   }
 
+  // Buffers with an aggregator (see setAggregator) accumulate every item and
+  // push a summary when their interval closes. The others sample.
   bool conditionalPushAll(BufferType& item) {
+    loadPending();
     bool pushed = false;
     for (int i = 0; i < Size; i++) {
       pushed |= buffers[i].conditionalPush(item);
@@ -148,20 +606,267 @@ public:
     return pushed;
   }
 
+  void setAggregator(int index, HistoryAggregator<BufferType>* aggregator) {
+    buffers[index].setAggregator(aggregator);
+  }
+
+  // If the buffer is waiting to be loaded lazily (see loadSplit), that happens now
   const HistoryBuffer<BufferType>& operator[](int index) const {
+    const_cast<HistoryBuffers*>(this)->ensureLoaded(index);
     return buffers[index];
   }
 
   HistoryBuffer<BufferType>& getMutable(int index) {
+    ensureLoaded(index);
     return buffers[index];
   }
 
 
 private:
-  static constexpr size_t MaxHistoryFileSize = 10000;
+  static constexpr const char* EpochKey = "epoch";
+  static constexpr size_t DefaultMaxJournalSize = 4096;
+  static constexpr size_t MaxJournalItemDocSize = 512;
 
   uint8_t nBuffersDescribed = 0;
   HistoryBuffer<BufferType> buffers[Size];
+
+  uint32_t _journalEpoch = 0;   // The epoch of the current snapshot
+  bool _journalValid = false;   // The snapshot and journal match the buffers, less unpersisted items
+
+  String _splitBase;                    // The base path of the per-buffer files
+  bool _splitBinary = false;
+  bool _pending[Size] = { };            // Waiting to be loaded from its file
+  bool _splitCurrent[Size] = { };       // The file matched the buffer at _splitGeneration
+  uint32_t _splitGeneration[Size] = { };
+
+  static String journalPath(const String& snapshotPath) { return snapshotPath + ".jnl"; }
+
+  struct StoreJob {
+    StoreJob(File f, const String& p) : file(f), out(file), path(p) { }
+
+    File file;
+    StaticBufferedWriteStream<> out;
+    String path;
+    uint32_t first[Size];     // The sequence numbers of the items to write, by buffer
+    uint32_t end[Size];
+    int tier = 0;             // The buffer being written
+    uint32_t next = 0;        // The sequence number of the next item to write
+    bool inTier = false;
+    bool wroteItem = false;
+    bool done = false;
+  };
+
+  struct LoadJob {
+    LoadJob(File f) : file(f), reader(file), itemDoc(MaxJournalItemDocSize) { }
+    ~LoadJob() { file.close(); }
+
+    File file;
+    JsonStreamReader reader;
+    DynamicJsonDocument itemDoc;
+    HistoryBuffer<BufferType>* buffer = nullptr;   // The buffer being loaded
+    bool inArray = false;
+    bool done = false;
+  };
+
+  StoreJob* _storeJob = nullptr;
+  LoadJob* _loadJob = nullptr;
+
+  void abortStore() {
+    if (_storeJob == nullptr) return;
+    _storeJob->done = false;
+    finishStore();
+  }
+
+  void abortLoad() {
+    delete _loadJob;
+    _loadJob = nullptr;
+  }
+
+  String splitPath(int index) const {
+    return _splitBase + "." + buffers[index]._name + (_splitBinary ? ".bin" : ".json");
+  }
+
+  void noteSplitCurrent(int index) {
+    _splitCurrent[index] = true;
+    _splitGeneration[index] = buffers[index].generation();
+  }
+
+  // The buffer stays pending if its file can't be loaded, so that storeSplit()
+  // doesn't replace the file with whatever part of it was read
+  bool ensureLoaded(int index) {
+    if (!_pending[index]) return true;
+
+    String path = splitPath(index);
+    if (!ESP_FS::exists(path)) {
+      buffers[index].clear();
+      _pending[index] = false;
+      return true;
+    }
+    bool loaded = _splitBinary ? buffers[index].loadBinary(path) : buffers[index].load(path);
+    if (!loaded) return false;
+    _pending[index] = false;
+    noteSplitCurrent(index);
+    return true;
+  }
+
+  bool loadPending() {
+    bool success = true;
+    for (int i = 0; i < Size; i++) success = ensureLoaded(i) && success;
+    return success;
+  }
+
+  bool writeSnapshot(Stream& writeStream, uint32_t epoch) {
+    loadPending();
+    writeStream.print("{ ");
+    if (epoch) {
+      writeStream.print('"'); writeStream.print(EpochKey); writeStream.print("\":");
+      writeStream.print(epoch); writeStream.print(", ");
+    }
+    for (int i = 0; i < Size; i++) {
+      if (i) writeStream.print(", ");
+      writeStream.print('"'); writeStream.print(buffers[i]._name); writeStream.print("\":");
+      buffers[i].store(writeStream);
+    }
+    writeStream.print(" }");
+
+    return !writeStream.getWriteError();
+  }
+
+  static bool readEpoch(JsonStreamReader& reader, uint32_t& epoch) {
+    long value;
+    if (!reader.readInteger(value)) return false;
+    epoch = value;
+    return true;
+  }
+
+  // Replay the entries of the journal that extend the current snapshot. Returns
+  // false if the journal can't be appended to as is, in which case the next
+  // persist() will write a new snapshot.
+  bool replayJournal(const String& path) {
+    File journal = ESP_FS::open(path, "r");
+    if (!journal) return !ESP_FS::exists(path);
+
+    JsonStreamReader reader(journal);
+    DynamicJsonDocument itemDoc(MaxJournalItemDocSize);
+    char name[JsonStreamReader::MaxKeySize];
+    bool current = false;
+    uint32_t nReplayed = 0;
+
+    while (reader.peek() >= 0 && reader.beginObject()) {
+      while (reader.nextMember(name, sizeof(name))) {
+        HistoryBuffer<BufferType>* buffer;
+        if (strcmp(name, EpochKey) == 0) {
+          uint32_t epoch;
+          if (!readEpoch(reader, epoch)) break;
+          current = (epoch == _journalEpoch);
+        } else if (current && (buffer = find(name)) != nullptr) {
+          if (!reader.read(itemDoc)) break;
+          buffer->push(itemDoc.as<JsonObjectConst>());
+          nReplayed++;
+        } else if (!reader.skipValue()) {
+          break;
+        }
+      }
+    }
+    journal.close();
+
+    for (int i = 0; i < Size; i++) buffers[i].loadComplete();
+
+    if (reader.failed()) Log.warning("History journal %s is damaged, replayed %d items", path.c_str(), nReplayed);
+    else Log.verbose("Replayed %d items from history journal %s", nReplayed, path.c_str());
+    return current && !reader.failed();
+  }
+
+  void markAllPersisted() {
+    for (int i = 0; i < Size; i++) buffers[i].markPersisted();
+  }
+
+  // A null selection means every buffer
+  bool loadSelected(Stream& readStream, const bool* selected) {
+    JsonStreamReader reader(readStream);
+    char name[JsonStreamReader::MaxKeySize];
+
+    if (selected) {
+      for (int i = 0; i < Size; i++) {
+        if (selected[i]) { buffers[i].clear(); _pending[i] = false; }
+      }
+    } else {
+      clearAll();
+      _journalEpoch = 0;
+    }
+    _journalValid = false;
+
+    if (reader.beginObject()) {
+      while (reader.nextMember(name, sizeof(name))) {
+        HistoryBuffer<BufferType>* buffer = find(name);
+        bool ok;
+        if (buffer && (!selected || selected[buffer - buffers])) ok = buffer->load(reader);
+        else if (!selected && strcmp(name, EpochKey) == 0) ok = readEpoch(reader, _journalEpoch);
+        else ok = reader.skipValue();
+        if (!ok) break;
+      }
+    }
+
+    if (reader.failed()) {
+      Log.warning(F("Failed to parse history stream"));
+      return false;
+    }
+
+    return true;
+  }
+
+  bool loadSelected(const String& historyFilePath, const bool* selected) {
+    File historyFile = ESP_FS::open(historyFilePath, "r");
+
+    if (!historyFile) {
+      Log.error(F("Failed to open history file for read: %s"), historyFilePath.c_str());
+      return false;
+    }
+
+    bool success = loadSelected(historyFile, selected);
+    historyFile.close();
+
+    if (success) Log.verbose("HistoryBuffers loaded from %s", historyFilePath.c_str());
+    else Log.warning("Error loading history from %s", historyFilePath.c_str());
+    
+    return success;
+  }
+
+  const bool* select(std::initializer_list<const char*> names, bool (&selected)[Size]) {
+    for (int i = 0; i < Size; i++) {
+      selected[i] = false;
+      for (const char* name : names) {
+        if (buffers[i]._name && strcmp(buffers[i]._name, name) == 0) selected[i] = true;
+      }
+    }
+    return selected;
+  }
+
+  HistoryBuffer<BufferType>* find(const char* name) {
+    for (int i = 0; i < Size; i++) {
+      if (buffers[i]._name && strcmp(buffers[i]._name, name) == 0) return &buffers[i];
+    }
+    return nullptr;
+  }
+};
+
+
+
+template<typename BufferType, int Size, size_t TotalElements>
+class StaticHistoryBuffers : public HistoryBuffers<BufferType, Size> {
+public:
+  bool init(const HBDescriptor (&descriptors)[Size]) {
+    size_t needed = totalHistoryElements(descriptors);
+    if (needed > TotalElements) {
+      Log.error(F("StaticHistoryBuffers: Descriptors need %d items, only %d available"), needed, TotalElements);
+      return false;
+    }
+    HistoryBuffers<BufferType, Size>::init(descriptors, _space);
+    return true;
+  }
+
+private:
+  BufferType _space[TotalElements];
 };
 
 #endif  // HistoryBuffers_h
\ No newline at end of file
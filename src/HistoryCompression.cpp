@@ -0,0 +1,125 @@
+/*
+ * HistoryCompression.cpp
+ *
+ */
+
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+//                                  Third Party Libraries
+//                                  Personal Libraries
+//                                  App Libraries and Includes
+#include "HistoryCompression.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+namespace HistoryCompression {
+  namespace internal {
+    uint8_t leadingZeros(uint32_t v) {
+      uint8_t n = 0;
+      for (uint32_t mask = 0x80000000UL; mask && !(v & mask); mask >>= 1) n++;
+      return n;
+    }
+
+    uint8_t trailingZeros(uint32_t v) {
+      uint8_t n = 0;
+      for (uint32_t mask = 1; mask && !(v & mask); mask <<= 1) n++;
+      return n;
+    }
+
+    inline uint32_t lowBits(uint8_t n) { return (n >= 32) ? 0xffffffffUL : (1UL << n) - 1; }
+
+    // Sign extend the low nBits of v
+    inline int32_t signExtend(uint32_t v, uint8_t nBits) {
+      uint32_t signBit = 1UL << (nBits - 1);
+      return static_cast<int32_t>((v ^ signBit) - signBit);
+    }
+  };
+
+
+  bool BitWriter::write(uint32_t value, uint8_t nBits) {
+    if (_overflowed || _position + nBits > _limit) {
+      _overflowed = true;
+      return false;
+    }
+    if (_data) {
+      for (uint8_t i = nBits; i > 0; i--) {
+        uint8_t mask = 0x80 >> (_position & 7);
+        uint8_t& byte = _data[_position >> 3];
+        if ((value >> (i - 1)) & 1) byte |= mask;
+        else byte &= ~mask;
+        _position++;
+      }
+    } else {
+      _position += nBits;
+    }
+    return true;
+  }
+
+  uint32_t BitReader::read(uint8_t nBits) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < nBits; i++) {
+      uint8_t bit = (_data[_position >> 3] >> (7 - (_position & 7))) & 1;
+      value = (value << 1) | bit;
+      _position++;
+    }
+    return value;
+  }
+
+
+  void writeDelta(BitWriter& out, int32_t d) {
+    uint32_t bits = static_cast<uint32_t>(d);
+    if (d == 0) out.write(0, 1);
+    else if (d >= -64 && d <= 63) { out.write(0x2, 2); out.write(bits, 7); }
+    else if (d >= -256 && d <= 255) { out.write(0x6, 3); out.write(bits, 9); }
+    else if (d >= -2048 && d <= 2047) { out.write(0xe, 4); out.write(bits, 12); }
+    else { out.write(0xf, 4); out.write(bits, 32); }
+  }
+
+  int32_t readDelta(BitReader& in) {
+    if (in.read(1) == 0) return 0;
+    if (in.read(1) == 0) return internal::signExtend(in.read(7), 7);
+    if (in.read(1) == 0) return internal::signExtend(in.read(9), 9);
+    if (in.read(1) == 0) return internal::signExtend(in.read(12), 12);
+    return static_cast<int32_t>(in.read(32));
+  }
+
+  void writeXor(BitWriter& out, XorState& state, uint32_t value) {
+    uint32_t x = value ^ state.previous;
+    state.previous = value;
+    if (x == 0) { out.write(0, 1); return; }
+
+    uint8_t leading = internal::leadingZeros(x);
+    uint8_t trailing = internal::trailingZeros(x);
+    if (leading > 31) leading = 31;   // Must fit in 5 bits
+
+    if (state.leading != XorState::NoWindow && leading >= state.leading && trailing >= state.trailing) {
+      out.write(0x2, 2);
+      out.write(x >> state.trailing, 32 - state.leading - state.trailing);
+      return;
+    }
+
+    uint8_t length = 32 - leading - trailing;
+    out.write(0x3, 2);
+    out.write(leading, 5);
+    out.write(length - 1, 5);
+    out.write(x >> trailing, length);
+    state.leading = leading;
+    state.trailing = trailing;
+  }
+
+  uint32_t readXor(BitReader& in, XorState& state) {
+    if (in.read(1) == 0) return state.previous;
+
+    if (in.read(1) == 1) {
+      state.leading = in.read(5);
+      uint8_t length = in.read(5) + 1;
+      state.trailing = 32 - state.leading - length;
+    }
+
+    uint8_t length = 32 - state.leading - state.trailing;
+    uint32_t x = (in.read(length) & internal::lowBits(length)) << state.trailing;
+    state.previous ^= x;
+    return state.previous;
+  }
+}
@@ -0,0 +1,92 @@
+/*
+ * HistoryCompression
+ *     Bit-level encoders used by CompressedHistoryBuffer to pack timestamps and
+ *     32-bit values in the style of Facebook's Gorilla time series database.
+ *
+ * NOTES:
+ * o Timestamps are stored as a delta-of-delta: the difference between this
+ *   item's delta and the previous item's delta. For readings taken at a
+ *   regular interval that is almost always 0, which takes a single bit:
+ *     0                  delta-of-delta is 0
+ *     10   + 7 bits      -64 .. 63
+ *     110  + 9 bits      -256 .. 255
+ *     1110 + 12 bits     -2048 .. 2047
+ *     1111 + 32 bits     anything else that fits in 32 bits
+ * o Values are XORed with the previous value. Since consecutive readings are
+ *   close, the result is mostly zero bits, and only the "meaningful" bits
+ *   between its leading and trailing zeros are stored:
+ *     0                  same as the previous value
+ *     10   + bits        the meaningful bits fall within the previous window
+ *     11   + 5 bits of leading zero count + 5 bits of (length - 1) + bits
+ * o Bits are written most significant first. The writer can also be run
+ *   without a buffer to measure how many bits something would take.
+ *
+ */
+
+#ifndef HistoryCompression_h
+#define HistoryCompression_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace HistoryCompression {
+
+  class BitWriter {
+  public:
+    // Write into data starting at bit position start, never going past
+    // limit bits. A null data pointer just counts.
+    BitWriter(uint8_t* data, size_t start, size_t limit) :
+        _data(data), _position(start), _limit(limit) { }
+
+    // Write the low nBits (<= 32) of value. Returns false, and stops writing
+    // altogether, if they don't fit.
+    bool write(uint32_t value, uint8_t nBits);
+
+    size_t position() const { return _position; }
+    bool overflowed() const { return _overflowed; }
+
+  private:
+    uint8_t* _data;
+    size_t _position;
+    size_t _limit;
+    bool _overflowed = false;
+  };
+
+  class BitReader {
+  public:
+    BitReader() = default;
+    BitReader(const uint8_t* data, size_t start = 0) : _data(data), _position(start) { }
+
+    uint32_t read(uint8_t nBits);
+    size_t position() const { return _position; }
+
+  private:
+    const uint8_t* _data = nullptr;
+    size_t _position = 0;
+  };
+
+
+  // The largest delta-of-delta that can be encoded
+  constexpr int64_t MaxDelta = INT32_MAX;
+  constexpr int64_t MinDelta = INT32_MIN;
+
+  void writeDelta(BitWriter& out, int32_t deltaOfDelta);
+  int32_t readDelta(BitReader& in);
+
+
+  // The context for XOR encoding one series of values
+  struct XorState {
+    static constexpr uint8_t NoWindow = 0xff;
+
+    uint32_t previous = 0;
+    uint8_t leading = NoWindow;   // The window of meaningful bits used last time
+    uint8_t trailing = 0;
+
+    void start(uint32_t first) { previous = first; leading = NoWindow; trailing = 0; }
+  };
+
+  void writeXor(BitWriter& out, XorState& state, uint32_t value);
+  uint32_t readXor(BitReader& in, XorState& state);
+}
+
+#endif  // HistoryCompression_h
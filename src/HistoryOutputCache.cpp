@@ -0,0 +1,65 @@
+/*
+ * HistoryOutputCache.cpp
+ *
+ */
+
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <string.h>
+//                                  Third Party Libraries
+//                                  Personal Libraries
+//                                  App Libraries and Includes
+#include "HistoryOutputCache.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+HistoryOutputCache::HistoryOutputCache(size_t size, BPAAllocator& allocator) {
+  _data = static_cast<uint8_t*>(allocator.allocate(size, 1));
+  _capacity = _data ? size : 0;
+  if (_data) _allocator = &allocator;
+}
+
+HistoryOutputCache::~HistoryOutputCache() {
+  if (_allocator) _allocator->deallocate(_data, _capacity, 1);
+}
+
+bool HistoryOutputCache::replay(Stream& target) {
+  _hits++;
+  bool success = (target.write(_data, _length) == _length);
+  target.flush();
+  return success && !target.getWriteError();
+}
+
+
+HistoryOutputCache::Recorder::Recorder(HistoryOutputCache& cache, Stream& target) :
+    _cache(cache), _target(target)
+{
+  // Whatever happens, the old contents are about to be overwritten
+  _cache.invalidate();
+  _cache._misses++;
+}
+
+size_t HistoryOutputCache::Recorder::write(const uint8_t* data, size_t size) {
+  if (!_overflowed) {
+    if (size <= _cache._capacity - _used) {
+      memcpy(_cache._data + _used, data, size);
+      _used += size;
+    } else {
+      _overflowed = true;
+    }
+  }
+  size_t written = _target.write(data, size);
+  if (written != size) setWriteError();
+  return written;
+}
+
+void HistoryOutputCache::Recorder::finish(
+    const void* owner, uint32_t generation, Format format, bool success)
+{
+  if (!success || _overflowed || getWriteError()) return;
+  _cache._owner = owner;
+  _cache._generation = generation;
+  _cache._format = format;
+  _cache._length = _used;
+}
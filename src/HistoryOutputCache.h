@@ -0,0 +1,117 @@
+/*
+ * HistoryOutputCache
+ *     Holds the bytes produced the last time a HistoryBuffer was stored, so
+ *     that storing it again before it has changed just replays them rather
+ *     than serializing every item again.
+ *
+ * NOTES:
+ * o A cache is filled and used by HistoryBufferBase::store(Stream&, cache) and
+ *   storeBinary(Stream&, cache). It remembers which buffer, which format, and
+ *   which generation of the buffer (see HistoryBufferBase::generation()) its
+ *   bytes came from. Anything else is a miss.
+ * o The space is provided by the caller (e.g. a region of PSRAM) or allocated
+ *   from a BPAAllocator when the cache is created. If a store produces more
+ *   bytes than fit, the output is still written in full, but it isn't cached.
+ * o Give each consumer that uses a different format its own cache. Consumers
+ *   that use the same format can share one.
+ *
+ * Usage:
+ *   HistoryOutputCache historyCache(4096);
+ *   ...
+ *   // In an HTTP handler
+ *   String etag = String(history.etag());
+ *   if (server.header("If-None-Match") == etag) { server.send(304); return; }
+ *   server.sendHeader("ETag", etag);
+ *   history.store(responseStream, historyCache);
+ *
+ */
+
+#ifndef HistoryOutputCache_h
+#define HistoryOutputCache_h
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <Arduino.h>
+//                                  Local Includes
+#include "BPAAllocator.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+class HistoryOutputCache {
+public:
+  enum class Format : uint8_t { None, Json, Binary };
+
+  // Use space provided by the caller
+  HistoryOutputCache(uint8_t* space, size_t size) : _data(space), _capacity(size) { }
+
+  // Allocate size bytes from allocator
+  HistoryOutputCache(size_t size, BPAAllocator& allocator = BPAAllocator::heap());
+
+  ~HistoryOutputCache();
+
+	/**
+	 * Disables copy constructor and assignment operator
+	 */
+  HistoryOutputCache(const HistoryOutputCache&) = delete;
+  HistoryOutputCache& operator=(const HistoryOutputCache&) = delete;
+
+  // Forget the cached bytes
+  void invalidate() { _format = Format::None; _length = 0; }
+
+  // True if the cache holds the output of owner at generation in the given format
+  bool holds(const void* owner, uint32_t generation, Format format) const {
+    return _format == format && format != Format::None && _owner == owner && _generation == generation;
+  }
+
+  size_t length() const { return _length; }
+  size_t capacity() const { return _capacity; }
+
+  // The number of stores that were answered from the cache, and that weren't
+  uint32_t hits() const { return _hits; }
+  uint32_t misses() const { return _misses; }
+
+  // ----- Used by HistoryBufferBase
+
+  // Write the cached bytes to target
+  bool replay(Stream& target);
+
+  // Passes output along to a target Stream and keeps a copy in the cache
+  class Recorder : public Stream {
+  public:
+    Recorder(HistoryOutputCache& cache, Stream& target);
+
+    // Keep what was recorded if it all fit and success is true
+    void finish(const void* owner, uint32_t generation, Format format, bool success);
+
+    // ----- Print
+    virtual size_t write(uint8_t c) override { return write(&c, 1); }
+    virtual size_t write(const uint8_t* data, size_t size) override;
+    virtual void flush() override { _target.flush(); }
+
+    // ----- Stream
+    virtual int available() override { return 0; }
+    virtual int read() override { return -1; }
+    virtual int peek() override { return -1; }
+
+  private:
+    HistoryOutputCache& _cache;
+    Stream& _target;
+    size_t _used = 0;
+    bool _overflowed = false;
+  };
+
+private:
+  uint8_t* _data;
+  size_t _capacity;
+  BPAAllocator* _allocator = nullptr;   // Non-null if the space was allocated here
+
+  const void* _owner = nullptr;
+  uint32_t _generation = 0;
+  Format _format = Format::None;
+  size_t _length = 0;
+
+  uint32_t _hits = 0;
+  uint32_t _misses = 0;
+};
+
+#endif  // HistoryOutputCache_h
@@ -0,0 +1,152 @@
+/*
+ * HistoryStats
+ *     Maintains min/max/mean/variance of one value of the items in a
+ *     HistoryBuffer, over the whole buffer or over the most recent N items,
+ *     as the items are pushed rather than by walking the buffer on demand.
+ *
+ * NOTES:
+ * o The value to track is chosen by an accessor function. A lambda without
+ *   captures will do: [](const THPReadings& r) { return r.temp; }
+ * o A HistoryStats object is attached to a buffer with HistoryBuffer::addStats().
+ *   From then on it is updated on every push, including the effect of the
+ *   oldest item leaving the window (or being overwritten). When it is attached
+ *   it picks up the items that are already in the buffer.
+ * o The mean and variance come from running sums, and min/max come from
+ *   monotonic deques, so every query is constant time and each push is
+ *   amortized constant time.
+ * o A window of 0 (or one larger than the buffer) covers the whole buffer.
+ * o The deques need room for up to one entry per item in the window. That
+ *   storage is allocated when the object is attached to a buffer, and replaced
+ *   if it is later attached with a different window. Attach each HistoryStats
+ *   object to only one buffer at a time.
+ *
+ * Usage:
+ *   HistoryStats<THPReadings> lastHourTemp([](const THPReadings& r) { return r.temp; }, 12);
+ *   history.addStats(lastHourTemp);
+ *   ...
+ *   Log.verbose("Max temp in the last hour: %F", lastHourTemp.max());
+ *
+ */
+
+#ifndef HistoryStats_h
+#define HistoryStats_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "BPACircularBuffer.h"
+
+template<typename ItemType, size_t Capacity> class HistoryBuffer;
+
+template<typename ItemType>
+class HistoryStats {
+public:
+  using Accessor = float (*)(const ItemType&);
+
+  HistoryStats(Accessor accessor, size_t window = 0) :
+      _accessor(accessor), _requestedWindow(window) { }
+
+	/**
+	 * Disables copy constructor and assignment operator
+	 */
+  HistoryStats(const HistoryStats&) = delete;
+  HistoryStats& operator=(const HistoryStats&) = delete;
+
+  // The number of items the statistics cover
+  size_t count() const { return _count; }
+
+  // The largest number of items the statistics will cover
+  size_t window() const { return _window; }
+
+  // These return NAN if there are no items
+  float min() const { return _count ? _minDeque.front().value : NAN; }
+  float max() const { return _count ? _maxDeque.front().value : NAN; }
+  float mean() const { return _count ? _sum / _count : NAN; }
+
+  // The population variance of the items in the window
+  float variance() const {
+    if (_count == 0) return NAN;
+    double m = _sum / _count;
+    double v = _sumSq / _count - m * m;
+    return (v > 0) ? v : 0;   // Rounding can leave a tiny negative value
+  }
+
+  float stddev() const { return sqrt(variance()); }
+
+  // Forget every item
+  void reset() {
+    _count = 0;
+    _seq = 0;
+    _sum = _sumSq = 0;
+    _minDeque.clear();
+    _maxDeque.clear();
+  }
+
+private:
+  template<typename, size_t> friend class HistoryBuffer;
+
+  struct Entry {
+    uint32_t seq;   // Which item the value came from, counting from 1
+    float value;
+  };
+
+  Accessor _accessor;
+  size_t _requestedWindow;
+  size_t _window = 0;
+  size_t _count = 0;
+  uint32_t _seq = 0;
+  double _sum = 0;
+  double _sumSq = 0;
+  BPACircularBuffer<Entry> _minDeque;   // Increasing values; the front is the minimum
+  BPACircularBuffer<Entry> _maxDeque;   // Decreasing values; the front is the maximum
+  float _leaving = 0;
+  bool _isLeaving = false;
+  HistoryStats* _next = nullptr;        // The next HistoryStats attached to the same buffer
+
+  // ----- Called by HistoryBuffer
+
+  void attach(size_t bufferCapacity) {
+    _window = (_requestedWindow == 0 || _requestedWindow > bufferCapacity) ? bufferCapacity : _requestedWindow;
+    if (_minDeque.capacity() != _window) {
+      _minDeque.init(_window);
+      _maxDeque.init(_window);
+    }
+    reset();
+  }
+
+  // An item is about to be added. If that pushes an item out of the window,
+  // this is it. It must be captured now since it may be about to be overwritten.
+  void beginAdd(const ItemType* leaving) {
+    _isLeaving = (leaving != nullptr);
+    if (_isLeaving) _leaving = _accessor(*leaving);
+  }
+
+  void endAdd(const ItemType& added) {
+    if (_window == 0) return;
+    float v = _accessor(added);
+    _seq++;
+
+    if (_isLeaving) {
+      _sum -= _leaving;
+      _sumSq -= static_cast<double>(_leaving) * _leaving;
+    } else {
+      _count++;
+    }
+    _sum += v;
+    _sumSq += static_cast<double>(v) * v;
+
+    // Drop the entry that just left the window, then anything the new value supersedes
+    expire(_minDeque);
+    expire(_maxDeque);
+    while (!_minDeque.isEmpty() && _minDeque.back().value >= v) _minDeque.pop();
+    while (!_maxDeque.isEmpty() && _maxDeque.back().value <= v) _maxDeque.pop();
+    _minDeque.push({_seq, v});
+    _maxDeque.push({_seq, v});
+  }
+
+  void expire(BPACircularBuffer<Entry>& deque) {
+    while (!deque.isEmpty() && deque.front().seq + _window <= _seq) deque.discardFront();
+  }
+};
+
+#endif  // HistoryStats_h
@@ -0,0 +1,120 @@
+/*
+ * JsonStreamReader.cpp
+ *
+ */
+
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+//                                  Third Party Libraries
+#include <ArduinoLog.h>
+#include <ArduinoJson.h>
+//                                  Personal Libraries
+//                                  App Libraries and Includes
+#include "JsonStreamReader.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+int JsonStreamReader::peek() {
+  if (_failed) return -1;
+  int c;
+  while ((c = _stream.peek()) == ' ' || c == '\n' || c == '\r' || c == '\t') {
+    _stream.read();
+  }
+  return c;
+}
+
+bool JsonStreamReader::consume(char c) {
+  if (peek() != c) return fail();
+  _stream.read();
+  return true;
+}
+
+bool JsonStreamReader::nextMember(char* key, size_t keySize) {
+  int c = peek();
+  if (c == ',') { _stream.read(); c = peek(); }
+  if (c == '}') { _stream.read(); return false; }
+  if (c != '"') return fail();
+  if (!readString(key, keySize)) return false;
+  return consume(':');
+}
+
+bool JsonStreamReader::nextElement() {
+  int c = peek();
+  if (c == ',') { _stream.read(); c = peek(); }
+  if (c == ']') { _stream.read(); return false; }
+  if (c < 0) return fail();
+  return true;
+}
+
+bool JsonStreamReader::read(JsonDocument& doc) {
+  if (peek() < 0) return fail();
+  auto error = deserializeJson(doc, _stream);
+  if (error) {
+    Log.warning(F("JsonStreamReader: Parse error: %s"), error.c_str());
+    return fail();
+  }
+  return true;
+}
+
+bool JsonStreamReader::readInteger(long& value) {
+  int c = peek();
+  bool negative = (c == '-');
+  if (negative) { _stream.read(); c = _stream.peek(); }
+  if (c < '0' || c > '9') return fail();
+
+  long v = 0;
+  while ((c = _stream.peek()) >= '0' && c <= '9') {
+    v = v * 10 + (c - '0');
+    _stream.read();
+  }
+  value = negative ? -v : v;
+  return true;
+}
+
+bool JsonStreamReader::skipValue() {
+  int c = peek();
+  if (c == '"') return readString(nullptr, 0);
+
+  if (c != '{' && c != '[') {
+    // A number, true, false, or null: everything up to the next delimiter
+    while ((c = _stream.peek()) >= 0 &&
+           c != ',' && c != '}' && c != ']' && c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+      _stream.read();
+    }
+    return true;
+  }
+
+  // An object or array: track nesting until it closes, stepping over strings
+  // since they may contain brackets
+  int depth = 0;
+  do {
+    c = _stream.peek();
+    if (c < 0) return fail();
+    if (c == '"') {
+      if (!readString(nullptr, 0)) return false;
+      continue;
+    }
+    _stream.read();
+    if (c == '{' || c == '[') depth++;
+    else if (c == '}' || c == ']') depth--;
+  } while (depth > 0);
+  return true;
+}
+
+bool JsonStreamReader::readString(char* buf, size_t bufSize) {
+  _stream.read();   // The opening quote
+  size_t len = 0;
+  for (;;) {
+    int c = _stream.read();
+    if (c < 0) return fail();
+    if (c == '"') break;
+    if (c == '\\') {
+      c = _stream.read();
+      if (c < 0) return fail();
+    }
+    if (len + 1 < bufSize) buf[len++] = c;
+  }
+  if (bufSize) buf[len] = '\0';
+  return true;
+}
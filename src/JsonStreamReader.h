@@ -0,0 +1,80 @@
+/*
+ * JsonStreamReader
+ *     Walks the structure of a JSON document as it is read from a Stream so that
+ *     large documents can be processed a piece at a time. The structural parts
+ *     (objects, arrays, and keys) are handled here, and individual values are
+ *     either skipped or deserialized into a (small) JsonDocument by the caller.
+ *
+ * NOTES:
+ * o Memory use is independent of the size of the document. Only the value
+ *   currently being deserialized needs to fit in the caller's JsonDocument.
+ * o The reader is lenient about commas: it doesn't complain about a missing
+ *   or extra one. It is meant for reading files we wrote, not for validation.
+ * o Once an error is encountered, every subsequent call fails.
+ *
+ * Usage:
+ *   JsonStreamReader reader(file);
+ *   char key[JsonStreamReader::MaxKeySize];
+ *   reader.beginObject();
+ *   while (reader.nextMember(key, sizeof(key))) {
+ *     if (strcmp(key, "items") != 0) { reader.skipValue(); continue; }
+ *     reader.beginArray();
+ *     while (reader.nextElement()) {
+ *       if (reader.read(itemDoc)) process(itemDoc.as<JsonObjectConst>());
+ *     }
+ *   }
+ *   if (reader.failed()) ...
+ *
+ */
+
+#ifndef JsonStreamReader_h
+#define JsonStreamReader_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class JsonStreamReader {
+public:
+  // Keys longer than this (including the terminator) are truncated
+  static constexpr size_t MaxKeySize = 32;
+
+  JsonStreamReader(Stream& stream) : _stream(stream) { }
+
+  // Consume the opening '{' or '[' of the next value
+  bool beginObject() { return consume('{'); }
+  bool beginArray() { return consume('['); }
+
+  // Advance to the next member of the current object and read its key. Returns
+  // false, having consumed the closing '}', when there are no more members.
+  // On return the stream is positioned at the member's value, which the caller
+  // must read or skip before asking for the next member.
+  bool nextMember(char* key, size_t keySize);
+
+  // Advance to the next element of the current array. Returns false, having
+  // consumed the closing ']', when there are no more elements.
+  bool nextElement();
+
+  // Deserialize the next value into doc
+  bool read(JsonDocument& doc);
+
+  // Read the next value, which must be an integer
+  bool readInteger(long& value);
+
+  // Consume the next value, whatever it is, without storing it
+  bool skipValue();
+
+  // Returns the next non-whitespace character without consuming it, or -1
+  int peek();
+
+  bool failed() const { return _failed; }
+
+private:
+  Stream& _stream;
+  bool _failed = false;
+
+  bool consume(char c);
+  bool readString(char* buf, size_t bufSize);
+  bool fail() { _failed = true; return false; }
+};
+
+#endif  // JsonStreamReader_h
@@ -0,0 +1,224 @@
+/*
+ * JsonWriter.cpp
+ *
+ */
+
+
+//--------------- Begin:  Includes ---------------------------------------------
+//                                  Core Libraries
+#include <math.h>
+//                                  Third Party Libraries
+//                                  Personal Libraries
+//                                  App Libraries and Includes
+#include "JsonWriter.h"
+//--------------- End:    Includes ---------------------------------------------
+
+
+namespace {
+  constexpr uint8_t MaxDecimals = 6;
+  constexpr uint32_t PowersOf10[MaxDecimals + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+  // Beyond this, values are written in exponential form so that scaling them
+  // by 10^decimals can't overflow
+  constexpr double LargestFixed = 1e12;
+
+  // ArduinoJson's defaults for doubles: 9 significant digits, and an exponent
+  // outside of [1e-5, 1e7)
+  constexpr uint32_t MaxSignificantPart = 1000000000;
+  constexpr uint8_t SignificantDigits = 9;
+  constexpr double PositiveExponentThreshold = 1e7;
+  constexpr double NegativeExponentThreshold = 1e-5;
+  constexpr double BinaryPowersOf10[] = { 1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256 };
+  constexpr double NegativeBinaryPowersOf10[] = { 1e-1, 1e-2, 1e-4, 1e-8, 1e-16, 1e-32, 1e-64, 1e-128, 1e-256 };
+};
+
+
+void JsonWriter::beginObject(const char* name) {
+  beginValue(name);
+  _stream.write('{');
+  if (_depth < MaxDepth - 1) _depth++;
+  _hasValue &= ~(1UL << _depth);
+}
+
+void JsonWriter::endObject() {
+  _stream.write('}');
+  if (_depth) _depth--;
+}
+
+void JsonWriter::beginArray(const char* name) {
+  beginValue(name);
+  _stream.write('[');
+  if (_depth < MaxDepth - 1) _depth++;
+  _hasValue &= ~(1UL << _depth);
+}
+
+void JsonWriter::endArray() {
+  _stream.write(']');
+  if (_depth) _depth--;
+}
+
+void JsonWriter::field(const char* name, const char* value) {
+  beginValue(name);
+  if (value) writeString(value);
+  else _stream.write("null");
+}
+
+void JsonWriter::field(const char* name, bool value) {
+  beginValue(name);
+  _stream.write(value ? "true" : "false");
+}
+
+void JsonWriter::field(const char* name, long long value) {
+  beginValue(name);
+  if (value < 0) {
+    _stream.write('-');
+    writeUnsigned(0ULL - static_cast<unsigned long long>(value));
+  } else {
+    writeUnsigned(value);
+  }
+}
+
+void JsonWriter::field(const char* name, unsigned long long value) {
+  beginValue(name);
+  writeUnsigned(value);
+}
+
+void JsonWriter::field(const char* name, double value, uint8_t decimals) {
+  beginValue(name);
+  writeFloat(value, decimals);
+}
+
+void JsonWriter::fieldNull(const char* name) {
+  beginValue(name);
+  _stream.write("null");
+}
+
+void JsonWriter::key(const char* name) {
+  beginValue(name);
+  _keyWritten = true;
+}
+
+void JsonWriter::beginValue(const char* name) {
+  if (_keyWritten) { _keyWritten = false; return; }
+  uint32_t bit = 1UL << _depth;
+  if (_hasValue & bit) _stream.write(',');
+  _hasValue |= bit;
+  if (name) {
+    writeString(name);
+    _stream.write(':');
+  }
+}
+
+void JsonWriter::writeString(const char* s) {
+  _stream.write('"');
+  const char* run = s;    // Write unescaped characters in runs rather than one at a time
+  for (; *s; s++) {
+    char c = *s;
+    if (c != '"' && c != '\\' && static_cast<uint8_t>(c) >= 0x20) continue;
+    _stream.write(run, s - run);
+    run = s + 1;
+    _stream.write('\\');
+    switch (c) {
+      case '"':  _stream.write('"'); break;
+      case '\\': _stream.write('\\'); break;
+      case '\n': _stream.write('n'); break;
+      case '\r': _stream.write('r'); break;
+      case '\t': _stream.write('t'); break;
+      default: {
+        char hex[6] = { 'u', '0', '0', "0123456789abcdef"[c >> 4], "0123456789abcdef"[c & 0xf], 0 };
+        _stream.write(hex, 5);
+      }
+    }
+  }
+  _stream.write(run, s - run);
+  _stream.write('"');
+}
+
+void JsonWriter::writeUnsigned(unsigned long long v) {
+  char digits[21];
+  char* p = digits + sizeof(digits);
+  do {
+    *--p = '0' + (v % 10);
+    v /= 10;
+  } while (v);
+  _stream.write(p, digits + sizeof(digits) - p);
+}
+
+void JsonWriter::writeFloat(double v, uint8_t decimals) {
+  if (isnan(v) || isinf(v)) { _stream.write("null"); return; }
+  if (v < 0) { _stream.write('-'); v = -v; }
+  if (decimals == AllDigits) { writeSignificant(v); return; }
+  if (decimals > MaxDecimals) decimals = MaxDecimals;
+
+  if (v >= LargestFixed) {
+    int exponent = static_cast<int>(floor(log10(v)));
+    writeFloat(v / pow(10, exponent), MaxDecimals);
+    _stream.write('e');
+    writeUnsigned(exponent);
+    return;
+  }
+
+  uint32_t scale = PowersOf10[decimals];
+  unsigned long long scaled = static_cast<unsigned long long>(v * scale + 0.5);
+  writeUnsigned(scaled / scale);
+
+  uint32_t fraction = scaled % scale;
+  if (fraction == 0) return;
+  while (fraction % 10 == 0) { fraction /= 10; decimals--; }   // Drop trailing zeros
+
+  char digits[MaxDecimals + 1];
+  digits[0] = '.';
+  for (uint8_t i = decimals; i > 0; i--) {
+    digits[i] = '0' + (fraction % 10);
+    fraction /= 10;
+  }
+  _stream.write(digits, decimals + 1);
+}
+
+// Write a finite, non-negative value the same way ArduinoJson does, so that
+// output matches what serializeJson() would have produced for it
+void JsonWriter::writeSignificant(double v) {
+  // Bring the value into [1, 10) if it is to have an exponent
+  int exponent = 0;
+  if (v >= PositiveExponentThreshold) {
+    for (int i = 8; i >= 0; i--) {
+      if (v >= BinaryPowersOf10[i]) { v *= NegativeBinaryPowersOf10[i]; exponent += 1 << i; }
+    }
+  } else if (v > 0 && v <= NegativeExponentThreshold) {
+    for (int i = 8; i >= 0; i--) {
+      if (v < NegativeBinaryPowersOf10[i] * 10) { v *= BinaryPowersOf10[i]; exponent -= 1 << i; }
+    }
+  }
+
+  // The digits of the integral part come out of the decimal places
+  uint32_t integral = static_cast<uint32_t>(v);
+  uint32_t maxDecimal = MaxSignificantPart;
+  uint8_t decimals = SignificantDigits;
+  for (uint32_t i = integral; i >= 10; i /= 10) { maxDecimal /= 10; decimals--; }
+
+  double remainder = (v - integral) * maxDecimal;
+  uint32_t decimal = static_cast<uint32_t>(remainder);
+  decimal += static_cast<uint32_t>((remainder - decimal) * 2);    // Round half up
+  if (decimal >= maxDecimal) {
+    decimal = 0;
+    integral++;
+    if (exponent && integral >= 10) { exponent++; integral = 1; }
+  }
+  while (decimals > 0 && decimal % 10 == 0) { decimal /= 10; decimals--; }
+
+  writeUnsigned(integral);
+  if (decimals) {
+    char digits[SignificantDigits + 1];
+    digits[0] = '.';
+    for (uint8_t i = decimals; i > 0; i--) {
+      digits[i] = '0' + (decimal % 10);
+      decimal /= 10;
+    }
+    _stream.write(digits, decimals + 1);
+  }
+  if (exponent) {
+    _stream.write('e');
+    if (exponent < 0) { _stream.write('-'); exponent = -exponent; }
+    writeUnsigned(exponent);
+  }
+}
@@ -0,0 +1,92 @@
+/*
+ * JsonWriter
+ *     Writes JSON directly to a Stream, one field at a time, without building
+ *     a JsonDocument first. This is how Serializable objects can externalize
+ *     themselves without any intermediate allocation.
+ *
+ * NOTES:
+ * o The writer keeps track of where commas are needed. Consecutive values
+ *   at the top level are also separated by commas, so a series of objects
+ *   written one after another forms the body of a JSON array.
+ * o Floating point values are written the way ArduinoJson writes them: up to
+ *   9 significant digits, switching to an exponent below 1e-5 and from 1e7 up.
+ *   A field may instead ask for a fixed number of decimal places (at most 6).
+ *   Either way, trailing zeros are dropped. Values that aren't finite are
+ *   written as null, just as ArduinoJson does.
+ * o Objects and arrays may be nested up to 32 levels deep.
+ *
+ * Usage:
+ *   JsonWriter writer(stream);
+ *   writer.beginObject();
+ *   writer.field("temp", temp, 1);
+ *   writer.field("timestamp", timestamp);
+ *   writer.endObject();
+ *
+ */
+
+#ifndef JsonWriter_h
+#define JsonWriter_h
+
+#include <Arduino.h>
+
+class JsonWriter {
+public:
+  static constexpr uint8_t AllDigits = 0xff;   // As many digits as ArduinoJson writes
+
+  JsonWriter(Stream& stream) : _stream(stream) { }
+
+  // Begin an object or array. Within an object, the name must be given.
+  void beginObject(const char* name = nullptr);
+  void endObject();
+  void beginArray(const char* name = nullptr);
+  void endArray();
+
+  // Write a named field of the current object
+  void field(const char* name, const char* value);
+  void field(const char* name, const String& value) { field(name, value.c_str()); }
+  void field(const char* name, bool value);
+  void field(const char* name, int value) { field(name, static_cast<long long>(value)); }
+  void field(const char* name, long value) { field(name, static_cast<long long>(value)); }
+  void field(const char* name, long long value);
+  void field(const char* name, unsigned int value) { field(name, static_cast<unsigned long long>(value)); }
+  void field(const char* name, unsigned long value) { field(name, static_cast<unsigned long long>(value)); }
+  void field(const char* name, unsigned long long value);
+  void field(const char* name, double value, uint8_t decimals = AllDigits);
+  void fieldNull(const char* name);
+
+  // Write the name of the next member of the current object. The value that
+  // follows may be written in any way, e.g. by an object's externalizeTo().
+  void key(const char* name);
+
+  // Write an element of the current array (or a top-level value)
+  void value(const char* v) { field(nullptr, v); }
+  void value(bool v) { field(nullptr, v); }
+  void value(int v) { field(nullptr, v); }
+  void value(long v) { field(nullptr, v); }
+  void value(long long v) { field(nullptr, v); }
+  void value(unsigned int v) { field(nullptr, v); }
+  void value(unsigned long v) { field(nullptr, v); }
+  void value(unsigned long long v) { field(nullptr, v); }
+  void value(double v, uint8_t decimals = AllDigits) { field(nullptr, v, decimals); }
+
+  // Start a value that the caller will write directly to the returned stream,
+  // for example using serializeJson(). Any needed separator and name are
+  // written first.
+  Stream& beginRawValue(const char* name = nullptr) { beginValue(name); return _stream; }
+
+private:
+  static constexpr uint8_t MaxDepth = 32;
+
+  Stream& _stream;
+  uint8_t _depth = 0;
+  uint32_t _hasValue = 0;   // Bit n is set once level n has had a value written
+  bool _keyWritten = false; // The separator and name of the next value are already out
+
+  void beginValue(const char* name);
+  void writeString(const char* s);
+  void writeUnsigned(unsigned long long v);
+  void writeFloat(double v, uint8_t decimals);
+  void writeSignificant(double v);
+};
+
+#endif  // JsonWriter_h
@@ -6,6 +6,10 @@
  * NOTES:
  * o This class may be used as (1) a base type from which other classes are derived,
  *   or (2) as a multiple inheritance mixin for a class derived from a base class
+ * o externalizeTo() is what HistoryBuffer uses when storing items. Classes that
+ *   are stored often should override it in addition to implementing externalize().
+ * o Classes that implement binarySize(), toBinary(), and fromBinary() can also be
+ *   stored in the binary history format.
  *
  */
 
@@ -13,6 +17,7 @@
 #define Serializable_h
 
 #include <ArduinoJson.h>
+#include "JsonWriter.h"
 
 class Serializable {
 public:
@@ -27,6 +32,25 @@ public:
   // to the stream passed as a parameter.
   virtual void externalize(Stream& writeStream) const = 0;
 
+  // Write a JSON representation of this object using writer. Override this
+  // to write fields directly rather than building a JsonDocument. By default
+  // it falls back to externalize().
+  virtual void externalizeTo(JsonWriter& writer) const {
+    externalize(writer.beginRawValue());
+  }
+
+  // ----- Optional fixed-size binary representation (see HistoryBinary.h)
+
+  // The number of bytes written by toBinary(). Every object of a given class
+  // must return the same value. 0 means there is no binary representation.
+  virtual size_t binarySize() const { return 0; }
+
+  // Write binarySize() bytes representing this object to dest
+  virtual void toBinary(uint8_t* dest) const { (void)dest; }
+
+  // Set this object from binarySize() bytes written by toBinary()
+  virtual void fromBinary(const uint8_t* src) { (void)src; }
+
   time_t timestamp;
 };
 